@@ -0,0 +1,358 @@
+#ifndef TUTORIAL_01_BATCH_DECODER_H
+#define TUTORIAL_01_BATCH_DECODER_H
+
+#include "iostream"
+#include "string"
+#include "vector"
+#include "deque"
+#include "algorithm"
+#include "SDL.h"
+#include "SDL_thread.h"
+#include "error-code.h"
+#include "video-input.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavutil/time.h"
+}
+
+// Packets a file decode before its job is queued again, small enough that short and long files balance over workers
+const int BATCH_PACKETS_PER_STEP = 64;
+
+// Files in flight for each worker when not given, a worker waiting on a read still find another file to decode
+const int BATCH_FILES_PER_WORKER = 2;
+
+// Max time an idle worker wait before looking for a job to steal again
+const Uint32 BATCH_IDLE_POLL_MS = 5;
+
+/**
+ * Outcome of one file of a batch.
+ */
+struct BATCH_FILE_RESULT {
+    std::string path;
+    long frames;
+    int error;
+};
+
+/**
+ * Decode many files with a fixed number of them in flight on one pool of worker threads.
+ *
+ * @note Each file in flight is a job owning its own VIDEO_INPUT (demuxer and single threaded decoder, parallelism
+ *       come from files). A step of a job open its file or decode a few packets, then the job go back on the deque of
+ *       the worker which ran it. Workers take newest job from back of their own deque, so a file mostly stay on the
+ *       core where its decoder state is warm, and when their deque is empty they steal oldest job from front of
+ *       another worker's deque. Once a file is done its job open next file of the list, so process and library
+ *       startup are paid once for the whole batch.
+ */
+struct BATCH_DECODER {
+private:
+    struct JOB {
+        size_t file;                // Index of file in list
+        VIDEO_INPUT input;
+        bool opened;
+        long frames;
+    };
+
+    struct WORKER {
+        BATCH_DECODER *owner;
+        size_t index;
+        SDL_Thread *thread;
+        SDL_mutex *mutex;           // Guard "jobs", taken by owner and by thieves
+        std::deque<JOB*> jobs;
+        long steals;
+    };
+
+    std::vector<std::string> paths;
+    std::vector<BATCH_FILE_RESULT> results;
+    std::vector<JOB> jobs;
+    std::vector<WORKER> workers;
+    IO_SERVICE *io_service;
+    STREAM_INFO_CACHE *stream_info_cache;
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    size_t next_file;
+    size_t active_jobs;
+    long total_frames;
+    long failed_files;
+    bool aborted;
+    int error;
+    double elapsed;
+
+    /**
+     * Give next file of list to job.
+     * @return false when every file has been given, job is then retired.
+     */
+    bool assign_next_file(JOB *job) {
+        SDL_LockMutex(this->mutex);
+        bool assigned = this->next_file < this->paths.size();
+        if (assigned) {
+            job->file   = this->next_file++;
+            job->opened = false;
+            job->frames = 0;
+        }
+        else {
+            this->active_jobs--;
+            SDL_CondBroadcast(this->cond);
+        }
+        SDL_UnlockMutex(this->mutex);
+
+        return assigned;
+    }
+
+    /**
+     * Close file of job and record its result.
+     */
+    void finish_file(JOB *job, int ret) {
+        close_video_input(&job->input);
+        this->results[job->file] = {this->paths[job->file], job->frames, ret};
+
+        SDL_LockMutex(this->mutex);
+        this->total_frames += job->frames;
+        if (ret < 0) this->failed_files++;
+        SDL_UnlockMutex(this->mutex);
+    }
+
+    static int receive_frames(JOB *job, AVFrame *frame) {
+        int ret = 0;
+
+        while ((ret = avcodec_receive_frame(job->input.video_codec_ctx, frame)) >= 0) {
+            job->frames++;
+            av_frame_unref(frame);
+        }
+
+        return (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) ? 0 : SEND_VIDEO_FRAME_ERROR;
+    }
+
+    /**
+     * Open file of job or decode next packets of it.
+     * @return 0 when file has more to decode, 1 when it is done or negative error code when it failed.
+     */
+    int step(JOB *job, AVPacket *packet, AVFrame *frame) {
+        int ret = 0;
+
+        if (!job->opened) {
+            ret = open_video_input(this->paths[job->file], true, 1, &job->input, this->io_service, this->stream_info_cache);
+            job->opened = ret == 0;
+            return ret;
+        }
+
+        for (int i = 0; i < BATCH_PACKETS_PER_STEP; ++i) {
+            if (av_read_frame(job->input.format_ctx, packet) < 0) {
+                avcodec_send_packet(job->input.video_codec_ctx, nullptr);
+                ret = receive_frames(job, frame);
+                return ret < 0 ? ret : 1;
+            }
+
+            if (packet->stream_index != job->input.video_stream_index) {
+                av_packet_unref(packet);
+                continue;
+            }
+
+            ret = avcodec_send_packet(job->input.video_codec_ctx, packet);
+            av_packet_unref(packet);
+            if (ret < 0 && ret != AVERROR(EAGAIN)) return SEND_VIDEO_PACKET_ERROR;
+
+            if ((ret = receive_frames(job, frame)) < 0) return ret;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Take newest job of worker, or steal oldest job of another worker.
+     * @return job or nullptr when every deque is empty.
+     */
+    JOB *take_job(WORKER *worker) {
+        JOB *job = nullptr;
+
+        SDL_LockMutex(worker->mutex);
+        if (!worker->jobs.empty()) {
+            job = worker->jobs.back();
+            worker->jobs.pop_back();
+        }
+        SDL_UnlockMutex(worker->mutex);
+
+        for (size_t i = 1; job == nullptr && i < this->workers.size(); ++i) {
+            WORKER *victim = &this->workers[(worker->index + i) % this->workers.size()];
+
+            SDL_LockMutex(victim->mutex);
+            if (!victim->jobs.empty()) {
+                job = victim->jobs.front();
+                victim->jobs.pop_front();
+                worker->steals++;
+            }
+            SDL_UnlockMutex(victim->mutex);
+        }
+
+        return job;
+    }
+
+    static int worker_thread(void *userdata) {
+        auto *worker = (WORKER*)userdata;
+        BATCH_DECODER *decoder = worker->owner;
+        AVPacket *packet = av_packet_alloc();
+        AVFrame *frame = av_frame_alloc();
+
+        if (packet == nullptr || frame == nullptr) {
+            std::cerr << "Can't alloc packet and frame for batch worker." << std::endl;
+            decoder->abort(ALLOC_FRAME_ERROR);
+        }
+
+        for (;;) {
+            JOB *job = decoder->is_aborted() ? nullptr : decoder->take_job(worker);
+
+            if (job == nullptr) {
+                // Jobs held by other workers may come back to a deque, only leave once every file is done
+                SDL_LockMutex(decoder->mutex);
+                bool done = decoder->aborted || decoder->active_jobs == 0;
+                if (!done) SDL_CondWaitTimeout(decoder->cond, decoder->mutex, BATCH_IDLE_POLL_MS);
+                SDL_UnlockMutex(decoder->mutex);
+
+                if (done) break;
+                continue;
+            }
+
+            int ret = decoder->step(job, packet, frame);
+            if (ret != 0) {
+                decoder->finish_file(job, ret < 0 ? ret : 0);
+                if (!decoder->assign_next_file(job)) continue;
+            }
+
+            SDL_LockMutex(worker->mutex);
+            worker->jobs.push_back(job);
+            SDL_UnlockMutex(worker->mutex);
+            SDL_CondSignal(decoder->cond);
+        }
+
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+        return 0;
+    }
+
+    bool is_aborted() {
+        SDL_LockMutex(this->mutex);
+        bool aborted = this->aborted;
+        SDL_UnlockMutex(this->mutex);
+
+        return aborted;
+    }
+
+    void abort(int ret) {
+        SDL_LockMutex(this->mutex);
+        if (this->error == 0) this->error = ret;
+        this->aborted = true;
+        SDL_CondBroadcast(this->cond);
+        SDL_UnlockMutex(this->mutex);
+    }
+
+public:
+    /**
+     * @param paths paths of input files.
+     * @param worker_count number of decoding threads.
+     * @param io_service I/O thread serving reads of every file, nullptr to read with file protocol.
+     * @param stream_info_cache cache letting files already probed skip probing, nullptr to always probe.
+     */
+    BATCH_DECODER(const std::vector<std::string> &paths, int worker_count, IO_SERVICE *io_service = nullptr,
+                  STREAM_INFO_CACHE *stream_info_cache = nullptr) {
+        this->paths             = paths;
+        this->io_service        = io_service;
+        this->stream_info_cache = stream_info_cache;
+        this->mutex             = SDL_CreateMutex();
+        this->cond              = SDL_CreateCond();
+        this->next_file         = 0;
+        this->active_jobs       = 0;
+        this->total_frames      = 0;
+        this->failed_files      = 0;
+        this->aborted           = false;
+        this->error             = 0;
+        this->elapsed           = 0.0;
+
+        this->workers.resize((size_t)std::max(1, worker_count));
+        for (size_t i = 0; i < this->workers.size(); ++i) {
+            this->workers[i].owner  = this;
+            this->workers[i].index  = i;
+            this->workers[i].thread = nullptr;
+            this->workers[i].mutex  = SDL_CreateMutex();
+            this->workers[i].steals = 0;
+        }
+    }
+
+    ~BATCH_DECODER() {
+        abort(0);
+        for (auto &worker : this->workers) {
+            if (worker.thread) SDL_WaitThread(worker.thread, nullptr);
+            SDL_DestroyMutex(worker.mutex);
+        }
+
+        // Jobs left open by an aborted batch
+        for (auto &job : this->jobs) close_video_input(&job.input);
+
+        SDL_DestroyCond(this->cond);
+        SDL_DestroyMutex(this->mutex);
+    }
+
+    BATCH_DECODER(const BATCH_DECODER&) = delete;
+    BATCH_DECODER &operator=(const BATCH_DECODER&) = delete;
+
+    /**
+     * Decode every file, block until all are done.
+     * @param files_in_flight number of files open at once, 0 for "BATCH_FILES_PER_WORKER" per worker.
+     * @return 0 when batch ran (files which failed are only counted) or negative error code on failure.
+     */
+    int run(int files_in_flight) {
+        int64_t started = av_gettime_relative();
+
+        if (files_in_flight <= 0) files_in_flight = (int)this->workers.size() * BATCH_FILES_PER_WORKER;
+
+        this->results.resize(this->paths.size());
+        this->jobs.resize(std::min((size_t)files_in_flight, this->paths.size()), JOB());
+        this->active_jobs = this->jobs.size();
+
+        // Jobs are dealt to workers in turn, stealing balance them afterwards
+        for (size_t i = 0; i < this->jobs.size(); ++i) {
+            assign_next_file(&this->jobs[i]);
+            this->workers[i % this->workers.size()].jobs.push_back(&this->jobs[i]);
+        }
+
+        for (auto &worker : this->workers) {
+            worker.thread = SDL_CreateThread(worker_thread, "batch-decoder", &worker);
+            if (worker.thread == nullptr) {
+                std::cerr << "Can't create batch decoder thread with error: " << SDL_GetError() << std::endl;
+                abort(CREATE_DECODER_THREAD_ERROR);
+                break;
+            }
+        }
+
+        for (auto &worker : this->workers) {
+            if (worker.thread) SDL_WaitThread(worker.thread, nullptr);
+            worker.thread = nullptr;
+        }
+
+        this->elapsed = (double)(av_gettime_relative() - started) / AV_TIME_BASE;
+        return this->error;
+    }
+
+    /**
+     * Get outcome of every file, in order of the list.
+     */
+    const std::vector<BATCH_FILE_RESULT> &file_results() const {
+        return this->results;
+    }
+
+    /**
+     * Print aggregate throughput of the batch.
+     */
+    void report() const {
+        long steals = 0;
+        for (auto &worker : this->workers) steals += worker.steals;
+
+        std::cout << "Batch: " << this->paths.size() << " files (" << this->failed_files << " failed), "
+                  << this->jobs.size() << " in flight on " << this->workers.size() << " workers, " << this->total_frames
+                  << " frames in " << this->elapsed << " s (" << (this->elapsed > 0 ? this->total_frames / this->elapsed : 0.0)
+                  << " frames/s, " << (this->elapsed > 0 ? (double)this->paths.size() / this->elapsed : 0.0)
+                  << " files/s), " << steals << " jobs stolen." << std::endl;
+    }
+};
+
+#endif //TUTORIAL_01_BATCH_DECODER_H
@@ -0,0 +1,121 @@
+#ifndef TUTORIAL_01_CONTACT_SHEET_H
+#define TUTORIAL_01_CONTACT_SHEET_H
+
+#include "iostream"
+#include "vector"
+#include "algorithm"
+#include "error-code.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libswscale/swscale.h"
+}
+
+// Number of thumbnails in each row of contact sheet
+const int CONTACT_SHEET_COLUMNS = 6;
+
+// Width of each thumbnail, height follow aspect ratio of video
+const int CONTACT_SHEET_THUMB_WIDTH = 240;
+
+// Max number of thumbnails, keyframes are picked evenly over duration of video
+const int CONTACT_SHEET_MAX_THUMBS = 48;
+
+/**
+ * RGB24 image made from thumbnails tiled left to right, top to bottom.
+ *
+ * @note Each thumbnail is scaled and converted by sws_scale straight into its tile, the sheet grow one row at a time.
+ *       Size of tiles is taken from the first frame, SwsContext follow size and format of each frame as decoded.
+ */
+struct CONTACT_SHEET {
+private:
+    SwsContext *sws_ctx;
+    int thumb_width;
+    int thumb_height;
+    int _count;
+    std::vector<uint8_t> pixels;
+
+public:
+    CONTACT_SHEET() {
+        this->sws_ctx       = nullptr;
+        this->thumb_width   = CONTACT_SHEET_THUMB_WIDTH;
+        this->thumb_height  = 0;
+        this->_count        = 0;
+    }
+
+    ~CONTACT_SHEET() {
+        sws_freeContext(this->sws_ctx);
+    }
+
+    /**
+     * Get number of thumbnails added.
+     * @return number of thumbnails.
+     */
+    int count() const {
+        return this->_count;
+    }
+
+    /**
+     * Width of whole sheet in pixels.
+     */
+    int width() const {
+        return this->thumb_width * CONTACT_SHEET_COLUMNS;
+    }
+
+    /**
+     * Height of whole sheet in pixels.
+     */
+    int height() const {
+        return this->thumb_height * ((this->_count + CONTACT_SHEET_COLUMNS - 1) / CONTACT_SHEET_COLUMNS);
+    }
+
+    /**
+     * Bytes of one row of pixels.
+     */
+    int linesize() const {
+        return this->width() * 3;
+    }
+
+    /**
+     * Pointer to first pixel.
+     */
+    uint8_t *data() {
+        return this->pixels.data();
+    }
+
+    /**
+     * Downsample frame into next tile.
+     * @param frame decoded frame, keyframes of another size than the first one are stretched to its tiles.
+     * @return 0 on success or negative error code on failure.
+     */
+    int add(const AVFrame *frame) {
+        if (this->_count == 0) {
+            this->thumb_width   = std::min(CONTACT_SHEET_THUMB_WIDTH, frame->width);
+            this->thumb_height  = std::max(1, (int)((int64_t)frame->height * this->thumb_width / frame->width));
+        }
+
+        this->sws_ctx = sws_getCachedContext(this->sws_ctx, frame->width, frame->height, (AVPixelFormat)frame->format,
+                                             this->thumb_width, this->thumb_height, AV_PIX_FMT_RGB24,
+                                             SWS_AREA, nullptr, nullptr, nullptr);
+        if (this->sws_ctx == nullptr) {
+            std::cerr << "Can't get sws context for thumbnails." << std::endl;
+            return GET_SWS_CTX_ERROR;
+        }
+
+        int column = this->_count % CONTACT_SHEET_COLUMNS;
+        int row = this->_count / CONTACT_SHEET_COLUMNS;
+
+        // Start a new row of tiles, unused tiles stay black
+        if (column == 0) {
+            this->pixels.resize(this->pixels.size() + (size_t)this->linesize() * this->thumb_height, 0);
+        }
+
+        uint8_t *tile[4] = {this->pixels.data() + (size_t)row * this->thumb_height * this->linesize() + column * this->thumb_width * 3};
+        int tile_linesize[4] = {this->linesize()};
+
+        sws_scale(this->sws_ctx, frame->data, frame->linesize, 0, frame->height, tile, tile_linesize);
+        this->_count++;
+        return 0;
+    }
+};
+
+#endif //TUTORIAL_01_CONTACT_SHEET_H
@@ -22,7 +22,21 @@ enum ERROR_CODE {
     SEND_VIDEO_PACKET_ERROR,
     SEND_VIDEO_FRAME_ERROR,
     GET_SWS_CTX_ERROR,
-    ALLOC_RGB_FRAME_ERROR
+    ALLOC_RGB_FRAME_ERROR,
+    INVALID_FRAME_TARGET_ERROR,
+    WRITE_IMAGE_ERROR,
+    SEEK_INPUT_ERROR,
+    CREATE_DECODER_THREAD_ERROR,
+    FIND_IMAGE_ENCODER_ERROR,
+    ALLOC_IMAGE_ENCODER_CTX_ERROR,
+    OPEN_IMAGE_ENCODER_ERROR,
+    ENCODE_IMAGE_ERROR,
+    CREATE_ENCODER_THREAD_ERROR,
+    CREATE_IO_THREAD_ERROR,
+    INVALID_IO_MODE_ERROR,
+    READ_BATCH_LIST_ERROR,
+    WRITE_SCAN_ERROR,
+    INCOMPLETE_SCAN_ERROR
 };
 
 #endif //TUTORIAL_01_ERROR_CODE_H
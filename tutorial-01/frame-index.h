@@ -0,0 +1,361 @@
+#ifndef TUTORIAL_01_FRAME_INDEX_H
+#define TUTORIAL_01_FRAME_INDEX_H
+
+#include "iostream"
+#include "string"
+#include "vector"
+#include "algorithm"
+#include "cstring"
+#include "sys/stat.h"
+#include "error-code.h"
+
+#ifndef _WIN32
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/mman.h"
+#endif
+
+extern "C" {
+#include "libavformat/avformat.h"
+}
+
+// Extension appended to input path for the sidecar file
+const char FRAME_INDEX_EXTENSION[] = ".fidx";
+
+// Bumped whenever layout of sidecar change, older sidecars are rebuilt
+const uint32_t FRAME_INDEX_VERSION = 1;
+
+/**
+ * Start of sidecar file, identify the input it was built from.
+ */
+struct FRAME_INDEX_HEADER {
+    char magic[4];              // "FIDX"
+    uint32_t version;
+    int64_t file_size;          // Size of input file when index was built
+    int64_t file_mtime;         // Modification time of input file when index was built
+    int32_t stream_index;
+    int32_t time_base_num;
+    int32_t time_base_den;
+    uint32_t entry_count;
+};
+
+/**
+ * One video frame, entries are stored in presentation order.
+ */
+struct FRAME_INDEX_ENTRY {
+    int64_t pts;                // dts when packet has no pts
+    int64_t dts;
+    int64_t pos;                // Byte position of packet in file, -1 when unknown
+    int32_t size;               // Packet size in bytes
+    int32_t decode_index;       // Index of packet in decode order
+    int32_t flags;              // AV_PKT_FLAG_* of packet
+    int32_t reserved;
+};
+
+static_assert(sizeof(FRAME_INDEX_HEADER) == 40, "Sidecar header must keep the same layout");
+static_assert(sizeof(FRAME_INDEX_ENTRY) == 40, "Sidecar entry must keep the same layout");
+
+/**
+ * Where to seek and how much to decode to get a frame.
+ */
+struct FRAME_SEEK_PLAN {
+    int64_t timestamp;          // pts of requested frame
+    int64_t seek_timestamp;     // pts of keyframe to seek to
+    int decode_count;           // Packets to send to decoder from keyframe until requested frame is in
+};
+
+/**
+ * Frame index of a video stream persisted in a sidecar file next to the input.
+ *
+ * @note First run demux the whole stream once and write "<input>.fidx", later runs map the sidecar and answer frame
+ *       number lookups without reading the input. Sidecar is rebuilt when size or modification time of input change.
+ *       When sidecar can't be written the index is still used from memory.
+ */
+struct FRAME_INDEX {
+private:
+    std::vector<uint8_t> storage;
+    void *mapping;
+    size_t mapping_size;
+    const FRAME_INDEX_HEADER *header;
+    const FRAME_INDEX_ENTRY *entries;
+    bool from_sidecar;
+
+    /**
+     * Check blob is a complete sidecar built from this input and stream.
+     */
+    static bool is_valid(const uint8_t *data, size_t size, const struct stat &info, int stream_index) {
+        if (size < sizeof(FRAME_INDEX_HEADER)) return false;
+
+        auto *header = (const FRAME_INDEX_HEADER*)data;
+        return memcmp(header->magic, "FIDX", 4) == 0
+               && header->version == FRAME_INDEX_VERSION
+               && header->file_size == (int64_t)info.st_size
+               && header->file_mtime == (int64_t)info.st_mtime
+               && header->stream_index == stream_index
+               && size == sizeof(FRAME_INDEX_HEADER) + (size_t)header->entry_count * sizeof(FRAME_INDEX_ENTRY);
+    }
+
+    void attach(const uint8_t *data) {
+        this->header = (const FRAME_INDEX_HEADER*)data;
+        this->entries = (const FRAME_INDEX_ENTRY*)(data + sizeof(FRAME_INDEX_HEADER));
+    }
+
+    /**
+     * Map or read sidecar, leave index empty when sidecar is missing or stale.
+     */
+    bool load(const std::string &sidecar_path, const struct stat &info, int stream_index) {
+#ifndef _WIN32
+        int fd = ::open(sidecar_path.data(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat sidecar_info = {};
+        if (fstat(fd, &sidecar_info) < 0 || sidecar_info.st_size < (off_t)sizeof(FRAME_INDEX_HEADER)) {
+            ::close(fd);
+            return false;
+        }
+
+        size_t size = (size_t)sidecar_info.st_size;
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) return false;
+
+        if (!is_valid((const uint8_t*)mapping, size, info, stream_index)) {
+            munmap(mapping, size);
+            return false;
+        }
+
+        this->mapping = mapping;
+        this->mapping_size = size;
+        attach((const uint8_t*)mapping);
+        return true;
+#else
+        FILE *file = fopen(sidecar_path.data(), "rb");
+        if (file == nullptr) return false;
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        this->storage.resize(size > 0 ? (size_t)size : 0);
+        size_t read = fread(this->storage.data(), 1, this->storage.size(), file);
+        fclose(file);
+
+        if (read != this->storage.size() || !is_valid(this->storage.data(), this->storage.size(), info, stream_index)) {
+            this->storage.clear();
+            return false;
+        }
+
+        attach(this->storage.data());
+        return true;
+#endif
+    }
+
+    /**
+     * Demux every packet of stream and build index in memory.
+     */
+    int build(const std::string &path, const struct stat &info, int stream_index) {
+        AVFormatContext *format_ctx = nullptr;
+        AVPacket *packet = nullptr;
+        std::vector<FRAME_INDEX_ENTRY> frames;
+
+        if (avformat_open_input(&format_ctx, path.data(), nullptr, nullptr) < 0) {
+            std::cerr << "Can't open input file for frame index." << std::endl;
+            return OPEN_INPUT_ERROR;
+        }
+
+        if (avformat_find_stream_info(format_ctx, nullptr) < 0 || stream_index >= (int)format_ctx->nb_streams) {
+            std::cerr << "Can't find stream info for frame index." << std::endl;
+            avformat_close_input(&format_ctx);
+            return FIND_STREAM_INFO_ERROR;
+        }
+
+        for (unsigned int i = 0; i < format_ctx->nb_streams; ++i) {
+            if ((int)i != stream_index) format_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+
+        if ((packet = av_packet_alloc()) == nullptr) {
+            std::cerr << "Can't alloc packet." << std::endl;
+            avformat_close_input(&format_ctx);
+            return ALLOC_PACKET_ERROR;
+        }
+
+        while (av_read_frame(format_ctx, packet) >= 0) {
+            if (packet->stream_index == stream_index) {
+                FRAME_INDEX_ENTRY entry = {};
+                entry.pts           = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+                entry.dts           = packet->dts;
+                entry.pos           = packet->pos;
+                entry.size          = packet->size;
+                entry.decode_index  = (int32_t)frames.size();
+                entry.flags         = packet->flags;
+                frames.push_back(entry);
+            }
+            av_packet_unref(packet);
+        }
+
+        AVRational time_base = format_ctx->streams[stream_index]->time_base;
+        av_packet_free(&packet);
+        avformat_close_input(&format_ctx);
+
+        std::stable_sort(frames.begin(), frames.end(), [](const FRAME_INDEX_ENTRY &a, const FRAME_INDEX_ENTRY &b) {
+            return a.pts < b.pts;
+        });
+
+        FRAME_INDEX_HEADER header = {};
+        memcpy(header.magic, "FIDX", 4);
+        header.version          = FRAME_INDEX_VERSION;
+        header.file_size        = (int64_t)info.st_size;
+        header.file_mtime       = (int64_t)info.st_mtime;
+        header.stream_index     = stream_index;
+        header.time_base_num    = time_base.num;
+        header.time_base_den    = time_base.den;
+        header.entry_count      = (uint32_t)frames.size();
+
+        this->storage.resize(sizeof(header) + frames.size() * sizeof(FRAME_INDEX_ENTRY));
+        memcpy(this->storage.data(), &header, sizeof(header));
+        if (!frames.empty()) memcpy(this->storage.data() + sizeof(header), frames.data(), frames.size() * sizeof(FRAME_INDEX_ENTRY));
+
+        attach(this->storage.data());
+        return 0;
+    }
+
+    /**
+     * Write index to sidecar with a single call.
+     */
+    bool save(const std::string &sidecar_path) const {
+        FILE *file = fopen(sidecar_path.data(), "wb");
+        if (file == nullptr) return false;
+
+        size_t written = fwrite(this->storage.data(), 1, this->storage.size(), file);
+        fclose(file);
+
+        if (written != this->storage.size()) {
+            remove(sidecar_path.data());
+            return false;
+        }
+
+        return true;
+    }
+
+public:
+    FRAME_INDEX() {
+        this->mapping       = nullptr;
+        this->mapping_size  = 0;
+        this->header        = nullptr;
+        this->entries       = nullptr;
+        this->from_sidecar  = false;
+    }
+
+    ~FRAME_INDEX() {
+#ifndef _WIN32
+        if (this->mapping) munmap(this->mapping, this->mapping_size);
+#endif
+    }
+
+    FRAME_INDEX(const FRAME_INDEX&) = delete;
+    FRAME_INDEX &operator=(const FRAME_INDEX&) = delete;
+
+    /**
+     * Load index of stream from sidecar, or build it and write sidecar when missing or stale.
+     * @param path path of input file.
+     * @param stream_index index of video stream.
+     * @return 0 on success or negative error code on failure.
+     */
+    int open(const std::string &path, int stream_index) {
+        struct stat info = {};
+        if (stat(path.data(), &info) < 0) {
+            std::cerr << "Can't stat input file for frame index." << std::endl;
+            return OPEN_INPUT_ERROR;
+        }
+
+        std::string sidecar_path = path + FRAME_INDEX_EXTENSION;
+        if ((this->from_sidecar = load(sidecar_path, info, stream_index))) return 0;
+
+        int ret = build(path, info, stream_index);
+        if (ret < 0) return ret;
+
+        if (!save(sidecar_path)) std::cerr << "Can't write frame index: " << sidecar_path << std::endl;
+        return 0;
+    }
+
+    /**
+     * True when index was read from an existing sidecar instead of demuxing input.
+     */
+    bool is_from_sidecar() const {
+        return this->from_sidecar;
+    }
+
+    /**
+     * Get number of frames in index.
+     */
+    size_t size() const {
+        return this->header ? this->header->entry_count : 0;
+    }
+
+    /**
+     * Get frame at index in presentation order.
+     */
+    const FRAME_INDEX_ENTRY &at(size_t index) const {
+        return this->entries[index];
+    }
+
+    /**
+     * Find keyframe to seek to and number of packets to decode for a frame.
+     * @param index frame index in presentation order.
+     * @param plan output plan.
+     * @return false when frame is not in index.
+     */
+    bool lookup(int64_t index, FRAME_SEEK_PLAN *plan) const {
+        if (index < 0 || (size_t)index >= size()) return false;
+
+        const FRAME_INDEX_ENTRY &frame = this->entries[index];
+        const FRAME_INDEX_ENTRY *keyframe = &this->entries[0];
+
+        // Nearest keyframe before frame in decode order, leading frames of open GOP need the keyframe after them
+        for (int64_t i = index; i >= 0; --i) {
+            if ((this->entries[i].flags & AV_PKT_FLAG_KEY) && this->entries[i].decode_index <= frame.decode_index) {
+                keyframe = &this->entries[i];
+                break;
+            }
+        }
+
+        plan->timestamp         = frame.pts;
+        plan->seek_timestamp    = keyframe->pts;
+        plan->decode_count      = std::max(1, frame.decode_index - keyframe->decode_index + 1);
+        return true;
+    }
+
+    /**
+     * Get pts of keyframe a seek to timestamp land on.
+     * @param timestamp timestamp in stream time base.
+     * @return pts of keyframe, AV_NOPTS_VALUE when timestamp is before first frame.
+     */
+    int64_t keyframe_before(int64_t timestamp) const {
+        const FRAME_INDEX_ENTRY *end = this->entries + size();
+        const FRAME_INDEX_ENTRY *next = std::upper_bound(this->entries, end, timestamp, [](int64_t value, const FRAME_INDEX_ENTRY &entry) {
+            return value < entry.pts;
+        });
+
+        for (const FRAME_INDEX_ENTRY *it = next; it != this->entries; --it) {
+            if ((it - 1)->flags & AV_PKT_FLAG_KEY) return (it - 1)->pts;
+        }
+
+        return AV_NOPTS_VALUE;
+    }
+
+    /**
+     * Same as "should_seek" of frame-seeker.h, but the keyframe is known exactly from index.
+     * @param position timestamp of last decoded frame, AV_NOPTS_VALUE when nothing decoded yet.
+     * @param target timestamp of next target.
+     * @return true when we should seek.
+     */
+    bool should_seek(int64_t position, int64_t target) const {
+        if (position == AV_NOPTS_VALUE) return true;
+        if (target <= position) return false;
+
+        int64_t keyframe = keyframe_before(target);
+        return keyframe != AV_NOPTS_VALUE && keyframe > position;
+    }
+};
+
+#endif //TUTORIAL_01_FRAME_INDEX_H
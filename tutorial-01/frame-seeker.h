@@ -0,0 +1,245 @@
+#ifndef TUTORIAL_01_FRAME_SEEKER_H
+#define TUTORIAL_01_FRAME_SEEKER_H
+
+#include "iostream"
+#include "cmath"
+#include "cstring"
+#include "error-code.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavutil/mathematics.h"
+}
+
+/**
+ * Get first timestamp of stream.
+ * @param stream video stream.
+ * @return start time in stream time base, 0 when container does not tell.
+ */
+inline int64_t stream_start_time(const AVStream *stream) {
+    return stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+}
+
+/**
+ * Convert frame index (in presentation order) to timestamp of that frame.
+ * @param stream video stream.
+ * @param frame_rate frame rate of stream.
+ * @param index frame index.
+ * @return timestamp in stream time base.
+ */
+inline int64_t frame_index_to_timestamp(const AVStream *stream, AVRational frame_rate, int64_t index) {
+    return stream_start_time(stream) + av_rescale_q(index, av_inv_q(frame_rate), stream->time_base);
+}
+
+/**
+ * Convert timestamp of a frame to its index in presentation order.
+ * @param stream video stream.
+ * @param frame_rate frame rate of stream.
+ * @param timestamp timestamp in stream time base.
+ * @return frame index, rounded to nearest frame.
+ */
+inline int64_t timestamp_to_frame_index(const AVStream *stream, AVRational frame_rate, int64_t timestamp) {
+    return av_rescale_q_rnd(timestamp - stream_start_time(stream), stream->time_base, av_inv_q(frame_rate),
+                            AV_ROUND_NEAR_INF);
+}
+
+/**
+ * Convert seconds from start of stream to timestamp.
+ * @param stream video stream.
+ * @param seconds time from first frame of stream.
+ * @return timestamp in stream time base.
+ */
+inline int64_t seconds_to_timestamp(const AVStream *stream, double seconds) {
+    return stream_start_time(stream) + av_rescale_q(llrint(seconds * AV_TIME_BASE), AV_TIME_BASE_Q, stream->time_base);
+}
+
+/**
+ * Parse a time from command line.
+ * @param arg seconds from start of stream ("12.5" or "12.5s") or timestamp in stream time base ("900000pts").
+ * @param stream video stream.
+ * @param timestamp output timestamp in stream time base.
+ * @return true on success, false when "arg" is not a valid time.
+ */
+inline bool parse_timestamp(const char *arg, const AVStream *stream, int64_t *timestamp) {
+    char *end = nullptr;
+    double value = strtod(arg, &end);
+
+    if (end == arg) return false;
+
+    if (strcmp(end, "pts") == 0) {
+        *timestamp = (int64_t)value;
+        return true;
+    }
+
+    if (value < 0 || (*end != '\0' && strcmp(end, "s") != 0)) return false;
+
+    *timestamp = seconds_to_timestamp(stream, value);
+    return true;
+}
+
+/**
+ * Seek to the nearest keyframe at or before timestamp and drop every frame buffered in decoder.
+ *
+ * @note After this, decoding forward from the next packet only touch the GOP which contain timestamp.
+ *
+ * @param format_ctx format context of input.
+ * @param codec_ctx opened decoder of stream.
+ * @param stream_index index of stream timestamp belong to.
+ * @param timestamp target timestamp in stream time base.
+ * @return >= 0 on success, negative AVERROR when input can't seek.
+ */
+inline int seek_to_timestamp(AVFormatContext *format_ctx, AVCodecContext *codec_ctx, int stream_index, int64_t timestamp) {
+    int ret = avformat_seek_file(format_ctx, stream_index, INT64_MIN, timestamp, timestamp, 0);
+    if (ret < 0) {
+        // Some demuxers only support the old API
+        ret = av_seek_frame(format_ctx, stream_index, timestamp, AVSEEK_FLAG_BACKWARD);
+    }
+
+    if (ret >= 0) avcodec_flush_buffers(codec_ctx);
+    return ret;
+}
+
+/**
+ * Seek to a keyframe whose exact pts is known (from a frame index) and flush decoder.
+ * @param format_ctx format context of input.
+ * @param codec_ctx opened decoder of stream, flushed after a successful seek.
+ * @param stream_index index of video stream.
+ * @param keyframe pts of keyframe.
+ * @return >= 0 on success, negative AVERROR when input can't seek.
+ */
+inline int seek_to_keyframe(AVFormatContext *format_ctx, AVCodecContext *codec_ctx, int stream_index, int64_t keyframe) {
+    int ret = av_seek_frame(format_ctx, stream_index, keyframe, AVSEEK_FLAG_BACKWARD);
+
+    if (ret >= 0) avcodec_flush_buffers(codec_ctx);
+    return ret;
+}
+
+/**
+ * Get the first frame shown at or after timestamp.
+ *
+ * @note We seek to the keyframe before timestamp and decode forward, so work is bounded by the GOP which contain
+ *       timestamp. Frames without timestamp are taken as they come, as we can't tell where they are.
+ *
+ * @param format_ctx format context of input.
+ * @param codec_ctx opened decoder of stream.
+ * @param stream_index index of video stream.
+ * @param timestamp target timestamp in stream time base.
+ * @param packet packet used for reading.
+ * @param frame output frame, must be unref by caller.
+ * @param decoded_count output number of frames decoded, can be nullptr.
+ * @return 0 on success, AVERROR_EOF when stream end before timestamp, negative error code on failure.
+ */
+inline int decode_frame_at(AVFormatContext *format_ctx, AVCodecContext *codec_ctx, int stream_index, int64_t timestamp,
+                           AVPacket *packet, AVFrame *frame, int *decoded_count) {
+    int ret = 0;
+    int decoded = 0;
+    bool eof = false;
+
+    if (seek_to_timestamp(format_ctx, codec_ctx, stream_index, timestamp) < 0) {
+        std::cerr << "Can't seek input to timestamp " << timestamp << "." << std::endl;
+        return SEEK_INPUT_ERROR;
+    }
+
+    while (!eof) {
+        if (av_read_frame(format_ctx, packet) < 0) {
+            eof = true;
+            ret = avcodec_send_packet(codec_ctx, nullptr);
+        }
+        else if (packet->stream_index != stream_index) {
+            av_packet_unref(packet);
+            continue;
+        }
+        else {
+            ret = avcodec_send_packet(codec_ctx, packet);
+            av_packet_unref(packet);
+        }
+
+        if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) return SEND_VIDEO_PACKET_ERROR;
+
+        while ((ret = avcodec_receive_frame(codec_ctx, frame)) >= 0) {
+            decoded++;
+
+            if (frame->best_effort_timestamp == AV_NOPTS_VALUE || frame->best_effort_timestamp >= timestamp) {
+                if (decoded_count) *decoded_count = decoded;
+                return 0;
+            }
+
+            av_frame_unref(frame);
+        }
+
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) return SEND_VIDEO_FRAME_ERROR;
+    }
+
+    if (decoded_count) *decoded_count = decoded;
+    return AVERROR_EOF;
+}
+
+// Without a seek index, targets closer than this are reached by decoding straight through (AV_TIME_BASE units)
+const int64_t BATCH_SEEK_DISTANCE = 4 * AV_TIME_BASE;
+
+/**
+ * A frame requested in batch extraction.
+ */
+struct FRAME_TARGET {
+    int64_t timestamp;      // Timestamp in stream time base
+    int64_t index;          // Frame index, used to name output
+    bool by_index;          // Given as frame index, timestamp is only estimated from frame rate
+    int64_t seek_timestamp; // pts of keyframe to seek to, from frame index
+    int decode_count;       // Packets from that keyframe until target is in decoder, 0 when not from frame index
+
+    bool operator<(const FRAME_TARGET &other) const {
+        return this->timestamp < other.timestamp;
+    }
+};
+
+/**
+ * Parse a frame target from command line.
+ * @param arg frame index ("343"), time in seconds ("12.5s") or timestamp in stream time base ("900000pts").
+ * @param stream video stream.
+ * @param frame_rate frame rate of stream.
+ * @param target output target.
+ * @return true on success, false when "arg" is not a valid target.
+ */
+inline bool parse_frame_target(const char *arg, const AVStream *stream, AVRational frame_rate, FRAME_TARGET *target) {
+    char *end = nullptr;
+    double value = strtod(arg, &end);
+
+    if (end == arg || value < 0) return false;
+
+    if (*end != '\0') {
+        if (!parse_timestamp(arg, stream, &target->timestamp)) return false;
+
+        target->index = timestamp_to_frame_index(stream, frame_rate, target->timestamp);
+        target->by_index = false;
+        return true;
+    }
+
+    target->index = (int64_t)value;
+    target->timestamp = frame_index_to_timestamp(stream, frame_rate, target->index);
+    target->by_index = true;
+    return true;
+}
+
+/**
+ * Decide reaching next target is cheaper by seeking or by decoding straight through from current position.
+ *
+ * @note When the demuxer has a seek index we seek only if there is a keyframe between current position and target,
+ *       otherwise seeking would land before current position anyway. Without index we use "BATCH_SEEK_DISTANCE".
+ *
+ * @param stream video stream.
+ * @param position timestamp of last decoded frame, AV_NOPTS_VALUE when nothing decoded yet.
+ * @param target timestamp of next target.
+ * @return true when we should seek.
+ */
+inline bool should_seek(AVStream *stream, int64_t position, int64_t target) {
+    if (position == AV_NOPTS_VALUE) return true;
+    if (target <= position) return false;
+
+    const AVIndexEntry *entry = avformat_index_get_entry_from_timestamp(stream, target, AVSEEK_FLAG_BACKWARD);
+    if (entry != nullptr) return entry->timestamp > position;
+
+    return av_rescale_q(target - position, stream->time_base, AV_TIME_BASE_Q) > BATCH_SEEK_DISTANCE;
+}
+
+#endif //TUTORIAL_01_FRAME_SEEKER_H
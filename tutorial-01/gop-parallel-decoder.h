@@ -0,0 +1,324 @@
+#ifndef TUTORIAL_01_GOP_PARALLEL_DECODER_H
+#define TUTORIAL_01_GOP_PARALLEL_DECODER_H
+
+#include "iostream"
+#include "string"
+#include "vector"
+#include "algorithm"
+#include "SDL.h"
+#include "SDL_thread.h"
+#include "error-code.h"
+#include "video-input.h"
+#include "frame-seeker.h"
+
+// Each worker get about this many segments so a slow segment does not leave other cores idle
+const int GOP_SEGMENTS_PER_WORKER = 4;
+
+// Max number of decoded segments waiting to be emitted for each worker, bound memory of out of order segments
+const int GOP_SEGMENTS_IN_FLIGHT_PER_WORKER = 2;
+
+/**
+ * Called for every decoded frame, in presentation order.
+ */
+typedef void (*GOP_FRAME_CALLBACK)(const AVFrame *frame, void *userdata);
+
+/**
+ * Range of the video starting at a keyframe, decoded by one worker.
+ */
+struct GOP_SEGMENT {
+    int64_t start;                  // pts of first keyframe of segment
+    int64_t end;                    // pts of first keyframe of next segment, INT64_MAX for last segment
+    std::vector<AVFrame*> frames;   // decoded frames, filled by worker
+    bool done;
+    int error;
+};
+
+/**
+ * Decode a whole file with several independent demuxer/decoder pairs at once.
+ *
+ * @note Keyframes are indexed first by a demux-only pass, then the file is split into keyframe aligned segments which
+ *       are decoded concurrently on a pool of SDL threads, each with its own VIDEO_INPUT. Decoded segments are emitted
+ *       in order so caller see frames in presentation order as with one decoder.
+ */
+struct GOP_PARALLEL_DECODER {
+private:
+    struct WORKER {
+        GOP_PARALLEL_DECODER *owner;
+        SDL_Thread *thread;
+    };
+
+    std::string path;
+    int worker_count;
+    IO_SERVICE *io_service;
+    STREAM_INFO_CACHE *stream_info_cache;
+    std::vector<int64_t> keyframes;
+    std::vector<GOP_SEGMENT> segments;
+    std::vector<WORKER> workers;
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    size_t next_segment;
+    size_t emitted_segments;
+    bool aborted;
+
+    /**
+     * Read every packet of video stream and record pts of keyframes.
+     * @return 0 on success or negative error code on failure.
+     */
+    int index_keyframes() {
+        VIDEO_INPUT input = {};
+        int ret = open_video_input(this->path, false, 0, &input, this->io_service, this->stream_info_cache);
+        if (ret < 0) return ret;
+
+        AVPacket *packet = av_packet_alloc();
+        if (packet == nullptr) {
+            std::cerr << "Can't alloc packet." << std::endl;
+            close_video_input(&input);
+            return ALLOC_PACKET_ERROR;
+        }
+
+        while (av_read_frame(input.format_ctx, packet) >= 0) {
+            int64_t timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+
+            if (packet->stream_index == input.video_stream_index && (packet->flags & AV_PKT_FLAG_KEY)
+                && timestamp != AV_NOPTS_VALUE) {
+                this->keyframes.push_back(timestamp);
+            }
+
+            av_packet_unref(packet);
+        }
+
+        av_packet_free(&packet);
+        close_video_input(&input);
+
+        std::sort(this->keyframes.begin(), this->keyframes.end());
+        this->keyframes.erase(std::unique(this->keyframes.begin(), this->keyframes.end()), this->keyframes.end());
+        return 0;
+    }
+
+    /**
+     * Split keyframes into segments with about the same number of GOPs.
+     */
+    void make_segments() {
+        size_t count = std::min(this->keyframes.size(), (size_t)this->worker_count * GOP_SEGMENTS_PER_WORKER);
+
+        for (size_t i = 0; i < count; ++i) {
+            size_t first = this->keyframes.size() * i / count;
+            size_t next = this->keyframes.size() * (i + 1) / count;
+
+            GOP_SEGMENT segment;
+            segment.start   = this->keyframes[first];
+            segment.end     = next < this->keyframes.size() ? this->keyframes[next] : INT64_MAX;
+            segment.done    = false;
+            segment.error   = 0;
+            this->segments.push_back(segment);
+        }
+    }
+
+    /**
+     * Keep decoded frame when it belong to segment.
+     */
+    static int receive_frames(AVCodecContext *codec_ctx, AVFrame *frame, GOP_SEGMENT *segment) {
+        int ret = 0;
+
+        while ((ret = avcodec_receive_frame(codec_ctx, frame)) >= 0) {
+            int64_t timestamp = frame->best_effort_timestamp;
+
+            if (timestamp != AV_NOPTS_VALUE && timestamp >= segment->start && timestamp < segment->end) {
+                AVFrame *kept = av_frame_alloc();
+                if (kept == nullptr) return ALLOC_FRAME_ERROR;
+
+                av_frame_move_ref(kept, frame);
+                segment->frames.push_back(kept);
+            }
+            else {
+                av_frame_unref(frame);
+            }
+        }
+
+        return (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) ? 0 : SEND_VIDEO_FRAME_ERROR;
+    }
+
+    /**
+     * Decode every frame with pts in [start, end) of segment.
+     *
+     * @note We also send the keyframe at "end" and the packets after it while their pts is before "end", these are
+     *       leading frames of an open GOP which belong to this segment but can only be decoded after next keyframe.
+     */
+    static int decode_segment(VIDEO_INPUT *input, AVPacket *packet, AVFrame *frame, GOP_SEGMENT *segment) {
+        int ret = 0;
+        bool passed_end = false;
+
+        if (seek_to_timestamp(input->format_ctx, input->video_codec_ctx, input->video_stream_index, segment->start) < 0) {
+            std::cerr << "Can't seek to segment start." << std::endl;
+            return SEEK_INPUT_ERROR;
+        }
+
+        while (av_read_frame(input->format_ctx, packet) >= 0) {
+            if (packet->stream_index != input->video_stream_index) {
+                av_packet_unref(packet);
+                continue;
+            }
+
+            int64_t timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            if (timestamp != AV_NOPTS_VALUE && timestamp >= segment->end) {
+                if (passed_end) {
+                    av_packet_unref(packet);
+                    break;
+                }
+                passed_end = true;
+            }
+
+            ret = avcodec_send_packet(input->video_codec_ctx, packet);
+            av_packet_unref(packet);
+            if (ret < 0 && ret != AVERROR(EAGAIN)) return SEND_VIDEO_PACKET_ERROR;
+
+            if ((ret = receive_frames(input->video_codec_ctx, frame, segment)) < 0) return ret;
+        }
+
+        // Drain frames left in decoder, next seek flush the decoder
+        avcodec_send_packet(input->video_codec_ctx, nullptr);
+        if ((ret = receive_frames(input->video_codec_ctx, frame, segment)) < 0) return ret;
+
+        std::sort(segment->frames.begin(), segment->frames.end(), [](const AVFrame *a, const AVFrame *b) {
+            return a->best_effort_timestamp < b->best_effort_timestamp;
+        });
+
+        return 0;
+    }
+
+    static int worker_thread(void *userdata) {
+        auto *worker = (WORKER*)userdata;
+        GOP_PARALLEL_DECODER *decoder = worker->owner;
+        VIDEO_INPUT input = {};
+        AVPacket *packet = av_packet_alloc();
+        AVFrame *frame = av_frame_alloc();
+
+        // Parallelism come from segments, so each decoder use one thread
+        int ret = open_video_input(decoder->path, true, 1, &input, decoder->io_service, decoder->stream_info_cache);
+        if (ret == 0 && (packet == nullptr || frame == nullptr)) ret = ALLOC_FRAME_ERROR;
+
+        for (;;) {
+            SDL_LockMutex(decoder->mutex);
+            size_t window = (size_t)decoder->worker_count * GOP_SEGMENTS_IN_FLIGHT_PER_WORKER;
+            while (!decoder->aborted && decoder->next_segment < decoder->segments.size()
+                   && decoder->next_segment >= decoder->emitted_segments + window) {
+                SDL_CondWait(decoder->cond, decoder->mutex);
+            }
+
+            if (decoder->aborted || decoder->next_segment >= decoder->segments.size()) {
+                SDL_UnlockMutex(decoder->mutex);
+                break;
+            }
+
+            GOP_SEGMENT *segment = &decoder->segments[decoder->next_segment++];
+            SDL_UnlockMutex(decoder->mutex);
+
+            int error = ret < 0 ? ret : decode_segment(&input, packet, frame, segment);
+
+            SDL_LockMutex(decoder->mutex);
+            segment->error = error;
+            segment->done = true;
+            SDL_CondBroadcast(decoder->cond);
+            SDL_UnlockMutex(decoder->mutex);
+        }
+
+        av_frame_free(&frame);
+        av_packet_free(&packet);
+        close_video_input(&input);
+        return 0;
+    }
+
+public:
+    /**
+     * @param path path of input file.
+     * @param worker_count number of decoding threads.
+     * @param io_service I/O thread serving reads of every worker, nullptr to read with file protocol.
+     * @param stream_info_cache cache letting workers skip probing, nullptr to probe in every worker.
+     */
+    GOP_PARALLEL_DECODER(const std::string &path, int worker_count, IO_SERVICE *io_service = nullptr,
+                         STREAM_INFO_CACHE *stream_info_cache = nullptr) {
+        this->path              = path;
+        this->worker_count      = std::max(1, worker_count);
+        this->io_service        = io_service;
+        this->stream_info_cache = stream_info_cache;
+        this->mutex             = SDL_CreateMutex();
+        this->cond              = SDL_CreateCond();
+        this->next_segment      = 0;
+        this->emitted_segments  = 0;
+        this->aborted           = false;
+    }
+
+    ~GOP_PARALLEL_DECODER() {
+        SDL_LockMutex(this->mutex);
+        this->aborted = true;
+        SDL_CondBroadcast(this->cond);
+        SDL_UnlockMutex(this->mutex);
+
+        for (auto &worker : this->workers) {
+            if (worker.thread) SDL_WaitThread(worker.thread, nullptr);
+        }
+
+        for (auto &segment : this->segments) {
+            for (auto &frame : segment.frames) av_frame_free(&frame);
+        }
+
+        SDL_DestroyCond(this->cond);
+        SDL_DestroyMutex(this->mutex);
+    }
+
+    size_t keyframe_count() const {
+        return this->keyframes.size();
+    }
+
+    size_t segment_count() const {
+        return this->segments.size();
+    }
+
+    /**
+     * Decode whole file, block until every frame has been passed to "on_frame".
+     * @param on_frame called for every frame in presentation order, on caller thread.
+     * @param userdata passed to "on_frame".
+     * @return 0 on success or negative error code on failure.
+     */
+    int run(GOP_FRAME_CALLBACK on_frame, void *userdata) {
+        int ret = index_keyframes();
+        if (ret < 0) return ret;
+
+        make_segments();
+        this->workers.resize(this->worker_count, {this, nullptr});
+
+        for (auto &worker : this->workers) {
+            worker.thread = SDL_CreateThread(worker_thread, "gop-decoder", &worker);
+            if (worker.thread == nullptr) {
+                std::cerr << "Can't create decoder thread with error: " << SDL_GetError() << std::endl;
+                return CREATE_DECODER_THREAD_ERROR;
+            }
+        }
+
+        /* Emit segments in order, frames of a segment are already sorted by pts */
+        for (size_t i = 0; i < this->segments.size(); ++i) {
+            GOP_SEGMENT *segment = &this->segments[i];
+
+            SDL_LockMutex(this->mutex);
+            while (!segment->done) SDL_CondWait(this->cond, this->mutex);
+            SDL_UnlockMutex(this->mutex);
+
+            if (segment->error < 0) return segment->error;
+
+            for (auto &frame : segment->frames) {
+                on_frame(frame, userdata);
+                av_frame_free(&frame);
+            }
+            segment->frames.clear();
+
+            SDL_LockMutex(this->mutex);
+            this->emitted_segments++;
+            SDL_CondBroadcast(this->cond);
+            SDL_UnlockMutex(this->mutex);
+        }
+
+        return 0;
+    }
+};
+
+#endif //TUTORIAL_01_GOP_PARALLEL_DECODER_H
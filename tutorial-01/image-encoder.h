@@ -0,0 +1,386 @@
+#ifndef TUTORIAL_01_IMAGE_ENCODER_H
+#define TUTORIAL_01_IMAGE_ENCODER_H
+
+#include "iostream"
+#include "string"
+#include "vector"
+#include "deque"
+#include "algorithm"
+#include "SDL.h"
+#include "SDL_thread.h"
+#include "error-code.h"
+#include "image-writer.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libswscale/swscale.h"
+}
+
+// Max number of frames waiting for an encoder for each worker, decoding block when queue is full
+const int ENCODE_QUEUE_PER_WORKER = 2;
+
+/**
+ * Settings shared by every encoder of the pool.
+ */
+struct ENCODE_SETTINGS {
+    int quality;                // 1 (worst) to 100 (best), 0 keep encoder default. Used by mjpeg and webp
+    int compression_level;      // -1 keep encoder default. zlib level for png, method for webp
+    bool mmap_output;           // Write raw images through a mapping of output file
+    int width;                  // Output width, 0 follow height and aspect ratio of frame (or keep frame width)
+    int height;                 // Output height, 0 follow width and aspect ratio of frame (or keep frame height)
+};
+
+/**
+ * Get size of output image.
+ * @param src_width width of frame.
+ * @param src_height height of frame.
+ * @param width requested width, 0 follow aspect ratio.
+ * @param height requested height, 0 follow aspect ratio.
+ * @param out_width output width, even so every encoder accept it.
+ * @param out_height output height, even so every encoder accept it.
+ */
+inline void output_image_size(int src_width, int src_height, int width, int height, int *out_width, int *out_height) {
+    if (width <= 0 && height <= 0) {
+        *out_width  = src_width;
+        *out_height = src_height;
+        return;
+    }
+
+    if (width <= 0) width = (int)((int64_t)src_width * height / src_height);
+    if (height <= 0) height = (int)((int64_t)src_height * width / src_width);
+
+    *out_width  = std::max(2, width & ~1);
+    *out_height = std::max(2, height & ~1);
+}
+
+/**
+ * Get image encoder from extension of path.
+ * @param path output path.
+ * @return codec id, AV_CODEC_ID_NONE when image is written raw (PPM or RGB24).
+ */
+inline AVCodecID image_codec_from_path(const std::string &path) {
+    size_t dot = path.rfind('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot);
+
+    if (extension == ".png") return AV_CODEC_ID_PNG;
+    if (extension == ".jpg" || extension == ".jpeg") return AV_CODEC_ID_MJPEG;
+    if (extension == ".webp") return AV_CODEC_ID_WEBP;
+    if (extension == ".bmp") return AV_CODEC_ID_BMP;
+    if (extension == ".tif" || extension == ".tiff") return AV_CODEC_ID_TIFF;
+
+    return AV_CODEC_ID_NONE;
+}
+
+/**
+ * Convert and encode frames to image files, each worker of the pool own one of these.
+ */
+struct IMAGE_ENCODER {
+private:
+    ENCODE_SETTINGS settings;
+    SwsContext *sws_ctx;
+    AVFrame *converted;
+    AVCodecContext *codec_ctx;
+    AVPacket *packet;
+    IMAGE_WRITER writer;
+
+    /**
+     * Get size frame is written at, width and height of settings only apply when it is resized.
+     */
+    void output_size(const AVFrame *frame, bool resize, int *width, int *height) const {
+        output_image_size(frame->width, frame->height, resize ? this->settings.width : 0, resize ? this->settings.height : 0,
+                          width, height);
+    }
+
+    /**
+     * Scale and convert frame to output size and given format in a single sws pass, result stay valid until next call.
+     */
+    AVFrame *convert(AVFrame *frame, AVPixelFormat format, bool resize) {
+        int width = 0, height = 0;
+        output_size(frame, resize, &width, &height);
+
+        if (frame->format == format && frame->width == width && frame->height == height) return frame;
+
+        if (this->converted->width != width || this->converted->height != height || this->converted->format != format) {
+            av_frame_unref(this->converted);
+            this->converted->width  = width;
+            this->converted->height = height;
+            this->converted->format = format;
+
+            if (av_frame_get_buffer(this->converted, 0) < 0) return nullptr;
+        }
+
+        // Area averaging keep detail when shrinking a lot, bilinear is enough for conversion only
+        int flags = width < frame->width || height < frame->height ? SWS_AREA : SWS_BILINEAR;
+        this->sws_ctx = sws_getCachedContext(this->sws_ctx, frame->width, frame->height, (AVPixelFormat)frame->format,
+                                             width, height, format,
+                                             flags, nullptr, nullptr, nullptr);
+        if (this->sws_ctx == nullptr) return nullptr;
+
+        sws_scale(this->sws_ctx, frame->data, frame->linesize, 0, frame->height, this->converted->data, this->converted->linesize);
+        return this->converted;
+    }
+
+    /**
+     * Open encoder for output size, encoder is kept while frames keep the same size and codec.
+     */
+    int open_encoder(AVCodecID codec_id, const AVFrame *frame, bool resize) {
+        int width = 0, height = 0;
+        output_size(frame, resize, &width, &height);
+
+        if (this->codec_ctx && this->codec_ctx->codec_id == codec_id
+            && this->codec_ctx->width == width && this->codec_ctx->height == height) {
+            return 0;
+        }
+
+        avcodec_free_context(&this->codec_ctx);
+
+        const AVCodec *codec = avcodec_find_encoder(codec_id);
+        if (codec == nullptr) {
+            std::cerr << "Can't find image encoder: " << avcodec_get_name(codec_id) << std::endl;
+            return FIND_IMAGE_ENCODER_ERROR;
+        }
+
+        if ((this->codec_ctx = avcodec_alloc_context3(codec)) == nullptr) {
+            std::cerr << "Can't alloc image encoder context." << std::endl;
+            return ALLOC_IMAGE_ENCODER_CTX_ERROR;
+        }
+
+        this->codec_ctx->width          = width;
+        this->codec_ctx->height         = height;
+        this->codec_ctx->time_base      = {1, 25};
+        this->codec_ctx->pix_fmt        = codec->pix_fmts
+                                          ? avcodec_find_best_pix_fmt_of_list(codec->pix_fmts, (AVPixelFormat)frame->format, 0, nullptr)
+                                          : AV_PIX_FMT_RGB24;
+        this->codec_ctx->thread_count   = 1;
+
+        // mjpeg refuse limited range YUV, full range format make sws expand the range while converting
+        if (codec_id == AV_CODEC_ID_MJPEG) this->codec_ctx->pix_fmt = AV_PIX_FMT_YUVJ420P;
+
+        if (this->settings.quality > 0) {
+            // mjpeg use qscale (2 best, 31 worst), webp use quality (0 to 100), both read from global_quality
+            int scale = codec_id == AV_CODEC_ID_MJPEG ? 2 + (100 - this->settings.quality) * 29 / 99 : this->settings.quality;
+            this->codec_ctx->flags          |= AV_CODEC_FLAG_QSCALE;
+            this->codec_ctx->global_quality = FF_QP2LAMBDA * scale;
+        }
+
+        if (this->settings.compression_level >= 0) {
+            this->codec_ctx->compression_level = this->settings.compression_level;
+        }
+
+        if (avcodec_open2(this->codec_ctx, codec, nullptr) < 0) {
+            std::cerr << "Can't open image encoder: " << avcodec_get_name(codec_id) << std::endl;
+            avcodec_free_context(&this->codec_ctx);
+            return OPEN_IMAGE_ENCODER_ERROR;
+        }
+
+        return 0;
+    }
+
+public:
+    explicit IMAGE_ENCODER(const ENCODE_SETTINGS &settings) : writer(settings.mmap_output) {
+        this->settings  = settings;
+        this->sws_ctx   = nullptr;
+        this->converted = av_frame_alloc();
+        this->codec_ctx = nullptr;
+        this->packet    = av_packet_alloc();
+    }
+
+    ~IMAGE_ENCODER() {
+        av_packet_free(&this->packet);
+        avcodec_free_context(&this->codec_ctx);
+        av_frame_free(&this->converted);
+        sws_freeContext(this->sws_ctx);
+    }
+
+    /**
+     * Convert, encode and write frame to image file.
+     * @param frame decoded frame in any pixel format, its "quality" may be set for the encoder.
+     * @param path output path, image format is taken from its extension.
+     * @param resize false to write frame at its own size, ignoring width and height of settings.
+     * @return 0 on success or negative error code on failure.
+     */
+    int encode(AVFrame *frame, const std::string &path, bool resize = true) {
+        AVCodecID codec_id = image_codec_from_path(path);
+
+        // PPM and raw images are written by IMAGE_WRITER
+        if (codec_id == AV_CODEC_ID_NONE) {
+            const AVFrame *rgb_frame = convert(frame, AV_PIX_FMT_RGB24, resize);
+            if (rgb_frame == nullptr) {
+                std::cerr << "Can't convert frame to RGB24." << std::endl;
+                return GET_SWS_CTX_ERROR;
+            }
+
+            return this->writer.write(path, rgb_frame->width, rgb_frame->height, rgb_frame->data[0], rgb_frame->linesize[0]);
+        }
+
+        int ret = open_encoder(codec_id, frame, resize);
+        if (ret < 0) return ret;
+
+        AVFrame *encoder_frame = convert(frame, this->codec_ctx->pix_fmt, resize);
+        if (encoder_frame == nullptr) {
+            std::cerr << "Can't convert frame for image encoder." << std::endl;
+            return GET_SWS_CTX_ERROR;
+        }
+
+        // With fixed qscale mpegvideo encoders (mjpeg) take lambda from quality of each frame, not from context
+        if (this->codec_ctx->flags & AV_CODEC_FLAG_QSCALE) encoder_frame->quality = this->codec_ctx->global_quality;
+
+        if (avcodec_send_frame(this->codec_ctx, encoder_frame) < 0 || avcodec_receive_packet(this->codec_ctx, this->packet) < 0) {
+            std::cerr << "Can't encode image: " << path << std::endl;
+            return ENCODE_IMAGE_ERROR;
+        }
+
+        FILE *file = fopen(path.data(), "wb");
+        if (file == nullptr) {
+            std::cerr << "Can't open output file: " << path << std::endl;
+            av_packet_unref(this->packet);
+            return WRITE_IMAGE_ERROR;
+        }
+
+        size_t written = fwrite(this->packet->data, 1, this->packet->size, file);
+        fclose(file);
+
+        ret = written == (size_t)this->packet->size ? 0 : WRITE_IMAGE_ERROR;
+        av_packet_unref(this->packet);
+        return ret;
+    }
+};
+
+/**
+ * Pool of SDL threads converting and encoding frames, so encoding overlap with decoding.
+ */
+struct IMAGE_ENCODE_POOL {
+private:
+    struct ENCODE_JOB {
+        AVFrame *frame;
+        std::string path;
+        bool resize;
+    };
+
+    ENCODE_SETTINGS settings;
+    std::deque<ENCODE_JOB> jobs;
+    std::vector<SDL_Thread*> threads;
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    bool finishing;
+    int error;
+    long encoded;
+
+    static int worker_thread(void *userdata) {
+        auto *pool = (IMAGE_ENCODE_POOL*)userdata;
+        IMAGE_ENCODER encoder(pool->settings);
+
+        SDL_LockMutex(pool->mutex);
+        for (;;) {
+            while (pool->jobs.empty() && !pool->finishing) SDL_CondWait(pool->cond, pool->mutex);
+            if (pool->jobs.empty()) break;
+
+            ENCODE_JOB job = pool->jobs.front();
+            pool->jobs.pop_front();
+            SDL_CondBroadcast(pool->cond);
+            SDL_UnlockMutex(pool->mutex);
+
+            int ret = encoder.encode(job.frame, job.path, job.resize);
+            av_frame_free(&job.frame);
+
+            SDL_LockMutex(pool->mutex);
+            if (ret < 0 && pool->error == 0) pool->error = ret;
+            if (ret == 0) pool->encoded++;
+        }
+        SDL_UnlockMutex(pool->mutex);
+
+        return 0;
+    }
+
+public:
+    explicit IMAGE_ENCODE_POOL(const ENCODE_SETTINGS &settings) {
+        this->settings  = settings;
+        this->mutex     = SDL_CreateMutex();
+        this->cond      = SDL_CreateCond();
+        this->finishing = false;
+        this->error     = 0;
+        this->encoded   = 0;
+    }
+
+    ~IMAGE_ENCODE_POOL() {
+        finish();
+
+        for (auto &job : this->jobs) av_frame_free(&job.frame);
+        SDL_DestroyCond(this->cond);
+        SDL_DestroyMutex(this->mutex);
+    }
+
+    /**
+     * Start worker threads.
+     * @param worker_count number of workers.
+     * @return 0 on success or negative error code on failure.
+     */
+    int start(int worker_count) {
+        for (int i = 0; i < std::max(1, worker_count); ++i) {
+            SDL_Thread *thread = SDL_CreateThread(worker_thread, "encoder", this);
+            if (thread == nullptr) {
+                std::cerr << "Can't create encoder thread with error: " << SDL_GetError() << std::endl;
+                return CREATE_ENCODER_THREAD_ERROR;
+            }
+            this->threads.push_back(thread);
+        }
+
+        return 0;
+    }
+
+    /**
+     * Queue frame to be written, block while queue is full.
+     * @param frame frame to write, a new reference is taken so caller can unref it right away.
+     * @param path output path.
+     * @param resize false to write frame at its own size, ignoring width and height of settings.
+     * @return 0 on success or negative error code of an earlier failed job.
+     */
+    int submit(const AVFrame *frame, const std::string &path, bool resize = true) {
+        AVFrame *job_frame = av_frame_clone(frame);
+        if (job_frame == nullptr) {
+            std::cerr << "Can't reference frame for encoder." << std::endl;
+            return ALLOC_FRAME_ERROR;
+        }
+
+        SDL_LockMutex(this->mutex);
+        size_t max_jobs = this->threads.size() * ENCODE_QUEUE_PER_WORKER;
+        while (this->jobs.size() >= max_jobs && this->error == 0) SDL_CondWait(this->cond, this->mutex);
+
+        int ret = this->error;
+        if (ret == 0) {
+            this->jobs.push_back({job_frame, path, resize});
+            SDL_CondBroadcast(this->cond);
+        }
+        else {
+            av_frame_free(&job_frame);
+        }
+        SDL_UnlockMutex(this->mutex);
+
+        return ret;
+    }
+
+    /**
+     * Wait until every queued frame is written and stop workers.
+     * @return 0 on success or negative error code of first failed job.
+     */
+    int finish() {
+        SDL_LockMutex(this->mutex);
+        this->finishing = true;
+        SDL_CondBroadcast(this->cond);
+        SDL_UnlockMutex(this->mutex);
+
+        for (auto &thread : this->threads) SDL_WaitThread(thread, nullptr);
+        this->threads.clear();
+
+        return this->error;
+    }
+
+    /**
+     * Get number of images written.
+     */
+    long written() const {
+        return this->encoded;
+    }
+};
+
+#endif //TUTORIAL_01_IMAGE_ENCODER_H
@@ -0,0 +1,177 @@
+#ifndef TUTORIAL_01_IMAGE_WRITER_H
+#define TUTORIAL_01_IMAGE_WRITER_H
+
+#include "iostream"
+#include "string"
+#include "vector"
+#include "cstring"
+#include "error-code.h"
+
+#ifndef _WIN32
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/mman.h"
+#endif
+
+/**
+ * Layout of image file.
+ */
+enum IMAGE_FORMAT {
+    IMAGE_FORMAT_PPM = 0,       // "P6" header followed by packed RGB24 rows
+    IMAGE_FORMAT_RAW            // Packed RGB24 rows only
+};
+
+/**
+ * Build output path from a naming pattern.
+ * @param pattern path where "%d" or "%0Nd" is replaced by frame index, e.g. "out/frame-%06d.ppm".
+ * @param index frame index.
+ * @return output path, same as "pattern" when it has no "%d".
+ */
+inline std::string format_output_path(const std::string &pattern, int64_t index) {
+    size_t start = pattern.find('%');
+    if (start == std::string::npos) return pattern;
+
+    size_t end = start + 1;
+    while (end < pattern.size() && isdigit((unsigned char)pattern[end])) end++;
+    if (end >= pattern.size() || pattern[end] != 'd') return pattern;
+
+    int width = end > start + 1 ? atoi(pattern.substr(start + 1, end - start - 1).data()) : 0;
+    char number[32];
+    snprintf(number, sizeof(number), "%0*lld", width, (long long)index);
+
+    return pattern.substr(0, start) + number + pattern.substr(end + 1);
+}
+
+/**
+ * Get image format from extension of path, ".rgb" and ".raw" are raw, everything else is PPM.
+ * @param path output path or naming pattern.
+ * @return one of IMAGE_FORMAT.
+ */
+inline IMAGE_FORMAT image_format_from_path(const std::string &path) {
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos) return IMAGE_FORMAT_PPM;
+
+    std::string extension = path.substr(dot);
+    return (extension == ".rgb" || extension == ".raw") ? IMAGE_FORMAT_RAW : IMAGE_FORMAT_PPM;
+}
+
+/**
+ * Write RGB24 images with rows packed to exactly "width * 3" bytes, so padding at end of each row is never written.
+ *
+ * @note By default header and pixels are packed into one reused buffer and written with a single call. With "use_mmap"
+ *       output file is sized first and rows are packed straight into the mapping (not available on Windows, where
+ *       buffered writing is used instead).
+ */
+struct IMAGE_WRITER {
+private:
+    std::vector<uint8_t> buffer;
+    bool use_mmap;
+
+    /**
+     * Build header of image.
+     */
+    static std::string make_header(IMAGE_FORMAT format, int width, int height) {
+        if (format == IMAGE_FORMAT_RAW) return "";
+
+        char header[64];
+        snprintf(header, sizeof(header), "P6 %d %d 255\n", width, height);
+        return header;
+    }
+
+    /**
+     * Copy rows into "dst" without padding.
+     */
+    static void pack_rows(uint8_t *dst, int width, int height, const uint8_t *data, int linesize) {
+        size_t row_size = (size_t)width * 3;
+
+        if ((size_t)linesize == row_size) {
+            memcpy(dst, data, row_size * height);
+            return;
+        }
+
+        for (int i = 0; i < height; ++i) {
+            memcpy(dst + i * row_size, data + (size_t)i * linesize, row_size);
+        }
+    }
+
+    int write_buffered(const std::string &path, const std::string &header, int width, int height, const uint8_t *data, int linesize) {
+        size_t size = header.size() + (size_t)width * 3 * height;
+        this->buffer.resize(size);
+
+        memcpy(this->buffer.data(), header.data(), header.size());
+        pack_rows(this->buffer.data() + header.size(), width, height, data, linesize);
+
+        FILE *file = fopen(path.data(), "wb");
+        if (file == nullptr) {
+            std::cerr << "Can't open output file: " << path << std::endl;
+            return WRITE_IMAGE_ERROR;
+        }
+
+        size_t written = fwrite(this->buffer.data(), 1, size, file);
+        fclose(file);
+
+        if (written != size) {
+            std::cerr << "Can't write output file: " << path << std::endl;
+            return WRITE_IMAGE_ERROR;
+        }
+
+        return 0;
+    }
+
+#ifndef _WIN32
+    static int write_mmap(const std::string &path, const std::string &header, int width, int height, const uint8_t *data, int linesize) {
+        size_t size = header.size() + (size_t)width * 3 * height;
+
+        int fd = open(path.data(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "Can't open output file: " << path << std::endl;
+            return WRITE_IMAGE_ERROR;
+        }
+
+        if (ftruncate(fd, (off_t)size) < 0) {
+            std::cerr << "Can't resize output file: " << path << std::endl;
+            close(fd);
+            return WRITE_IMAGE_ERROR;
+        }
+
+        void *mapping = mmap(nullptr, size, PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            std::cerr << "Can't map output file: " << path << std::endl;
+            return WRITE_IMAGE_ERROR;
+        }
+
+        memcpy(mapping, header.data(), header.size());
+        pack_rows((uint8_t*)mapping + header.size(), width, height, data, linesize);
+        munmap(mapping, size);
+
+        return 0;
+    }
+#endif
+
+public:
+    explicit IMAGE_WRITER(bool use_mmap = false) {
+        this->use_mmap = use_mmap;
+    }
+
+    /**
+     * Write RGB24 image to file.
+     * @param path output path, format is taken from its extension.
+     * @param width width of image.
+     * @param height height of image.
+     * @param data first pixel of image.
+     * @param linesize bytes between start of two rows, can be bigger than "width * 3".
+     * @return 0 on success or negative error code on failure.
+     */
+    int write(const std::string &path, int width, int height, const uint8_t *data, int linesize) {
+        std::string header = make_header(image_format_from_path(path), width, height);
+
+#ifndef _WIN32
+        if (this->use_mmap) return write_mmap(path, header, width, height, data, linesize);
+#endif
+
+        return write_buffered(path, header, width, height, data, linesize);
+    }
+};
+
+#endif //TUTORIAL_01_IMAGE_WRITER_H
@@ -1,51 +1,527 @@
 #include "iostream"
+#include "vector"
+#include "algorithm"
 #include "SDL.h"
 #include "error-code.h"
+#include "frame-seeker.h"
+#include "contact-sheet.h"
+#include "image-writer.h"
+#include "image-encoder.h"
+#include "frame-index.h"
+#include "scene-detector.h"
+#include "video-input.h"
+#include "mmap-input.h"
+#include "uring-input.h"
+#include "memory-input.h"
+#include "stream-select.h"
+#include "gop-parallel-decoder.h"
+#include "batch-decoder.h"
+#include "packet-scanner.h"
 
 extern "C" {
 #include "libavformat/avformat.h"
 #include "libavcodec/avcodec.h"
 #include "libswscale/swscale.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/time.h"
 }
 
 using namespace std;
 
-void save_frame(AVCodecContext *video_codec_ctx, uint8_t *rgb_frame[4], int rgb_frame_linesize[4]) {
-    FILE *file = nullptr;
-    file = fopen("frame.ppm", "wb");
+/**
+ * Decode only keyframes and tile them into a contact sheet image.
+ *
+ * @note Non-key packets are never sent to decoder and decoder is told to skip non-key frames too, so the cost is
+ *       about one intra frame decode per thumbnail. Keyframes are picked evenly over duration of the video.
+ *
+ * @param format_ctx format context of input.
+ * @param video_codec_ctx opened video decoder.
+ * @param video_stream_index index of video stream.
+ * @param encoder encode pool writing the sheet.
+ * @param path path of output image.
+ * @return 0 on success or negative error code on failure.
+ */
+int make_contact_sheet(AVFormatContext *format_ctx, AVCodecContext *video_codec_ctx, int video_stream_index,
+                       IMAGE_ENCODE_POOL *encoder, const string &path) {
+    int             ret             = 0;
+    AVStream        *video_stream   = format_ctx->streams[video_stream_index];
+    AVPacket        *packet         = av_packet_alloc();
+    AVFrame         *frame          = av_frame_alloc();
+    int64_t         started         = av_gettime_relative();
+    int64_t         next_thumb      = AV_NOPTS_VALUE;
+    int64_t         thumb_interval  = 0;
+    int             packet_count    = 0;
+    int             keyframe_count  = 0;
+    bool            eof             = false;
+    CONTACT_SHEET   sheet;
+
+    if (packet == nullptr || frame == nullptr) {
+        cerr << "Can't alloc packet or frame." << endl;
+        ret = ALLOC_FRAME_ERROR;
+    }
+
+    video_codec_ctx->skip_frame = AVDISCARD_NONKEY;
+
+    // Space thumbnails evenly when duration is known, otherwise take keyframes until sheet is full
+    if (video_stream->duration != AV_NOPTS_VALUE && video_stream->duration > 0) {
+        thumb_interval = video_stream->duration / CONTACT_SHEET_MAX_THUMBS;
+    }
+
+    while (ret >= 0 && !eof && sheet.count() < CONTACT_SHEET_MAX_THUMBS) {
+        // On end of file send a null packet, keyframes still held by decoder (frame threads, reorder delay) come out
+        if (av_read_frame(format_ctx, packet) < 0) {
+            eof = true;
+            ret = avcodec_send_packet(video_codec_ctx, nullptr);
+        }
+        else if (packet->stream_index != video_stream_index || !(packet->flags & AV_PKT_FLAG_KEY)) {
+            av_packet_unref(packet);
+            continue;
+        }
+        else {
+            packet_count++;
+            if (next_thumb != AV_NOPTS_VALUE && packet->pts != AV_NOPTS_VALUE && packet->pts < next_thumb) {
+                av_packet_unref(packet);
+                continue;
+            }
+
+            ret = avcodec_send_packet(video_codec_ctx, packet);
+            av_packet_unref(packet);
+        }
+
+        if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+            cerr << "Error when sending video packet." << endl;
+            ret = SEND_VIDEO_PACKET_ERROR;
+            break;
+        }
+
+        while ((ret = avcodec_receive_frame(video_codec_ctx, frame)) >= 0) {
+            keyframe_count++;
+            // Tiles are scaled from each decoded frame, codec context size and format may not match keyframes
+            if (sheet.count() < CONTACT_SHEET_MAX_THUMBS && (ret = sheet.add(frame)) < 0) break;
+
+            if (frame->best_effort_timestamp != AV_NOPTS_VALUE) next_thumb = frame->best_effort_timestamp + thumb_interval;
+            av_frame_unref(frame);
+        }
+
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            ret = 0;
+        }
+        else if (ret != GET_SWS_CTX_ERROR) {
+            cerr << "Error when receive video frame." << endl;
+            ret = SEND_VIDEO_FRAME_ERROR;
+        }
+    }
+
+    if (ret >= 0 && sheet.count() > 0) {
+        /* Wrap sheet pixels in a frame so it go through the same encoders as extracted frames, "--width" and "--height"
+         * are for extracted frames and must not resize the whole sheet */
+        frame->width        = sheet.width();
+        frame->height       = sheet.height();
+        frame->format       = AV_PIX_FMT_RGB24;
+        frame->data[0]      = sheet.data();
+        frame->linesize[0]  = sheet.linesize();
+
+        ret = encoder->submit(frame, path, false);
+        av_frame_unref(frame);
+    }
+
+    if (ret >= 0) {
+        cout << "Contact sheet with " << sheet.count() << " thumbnails from " << keyframe_count << " decoded keyframes ("
+             << packet_count << " keyframe packets) in " << (av_gettime_relative() - started) / 1000 << " ms." << endl;
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    return ret;
+}
 
-    fprintf(file, "P6 %d %d 255\n", video_codec_ctx->width, video_codec_ctx->height);
+/**
+ * Frames seen by "--gop-parallel" pass, used to check order and measure throughput.
+ */
+struct GOP_PASS_STATS {
+    long frames;
+    long out_of_order;
+    int64_t last_timestamp;
+};
+
+void count_gop_frame(const AVFrame *frame, void *userdata) {
+    auto *stats = (GOP_PASS_STATS*)userdata;
+
+    if (stats->frames > 0 && frame->best_effort_timestamp <= stats->last_timestamp) stats->out_of_order++;
+    stats->last_timestamp = frame->best_effort_timestamp;
+    stats->frames++;
+}
 
-    for (int i = 0; i < video_codec_ctx->height; ++i) {
-        fwrite(rgb_frame[0] + i * rgb_frame_linesize[0], 1, rgb_frame_linesize[0], file);
+/**
+ * Decode whole video and print timestamp of every scene change.
+ *
+ * @note The pass has its own input with a multi-threaded decoder which skip the loop filter, small artifacts do not
+ *       change a luma thumbnail. Audio and other streams are discarded by the demuxer.
+ *
+ * @param path path of input file.
+ * @param encoder encode pool used to save first frame of each scene, nullptr to only print timestamps.
+ * @param pattern output path of scene images, "%d" is replaced by scene number.
+ * @param io_service service reading input, nullptr to read it with the file protocol.
+ * @param stream_info_cache cache of stream info, nullptr to probe input.
+ * @return 0 on success or negative error code on failure.
+ */
+int detect_scenes(const string &path, IMAGE_ENCODE_POOL *encoder, const string &pattern, IO_SERVICE *io_service,
+                  STREAM_INFO_CACHE *stream_info_cache) {
+    int             ret             = 0;
+    VIDEO_INPUT     input           = {};
+    AVPacket        *packet         = av_packet_alloc();
+    AVFrame         *frame          = av_frame_alloc();
+    int64_t         started         = av_gettime_relative();
+    int64_t         first_timestamp = AV_NOPTS_VALUE;
+    int64_t         last_timestamp  = AV_NOPTS_VALUE;
+    long            frame_count     = 0;
+    int             scene_count     = 0;
+    bool            eof             = false;
+    SCENE_DETECTOR  detector;
+    SCENE_SCORE     score           = {};
+
+    if (packet == nullptr || frame == nullptr) {
+        cerr << "Can't alloc packet or frame." << endl;
+        return ALLOC_FRAME_ERROR;
     }
 
+    if ((ret = open_video_input(path, true, 0, &input, io_service, stream_info_cache)) < 0) return ret;
+    input.video_codec_ctx->skip_loop_filter = AVDISCARD_ALL;
+
+    while (!eof) {
+        if (av_read_frame(input.format_ctx, packet) < 0) {
+            eof = true;
+            ret = avcodec_send_packet(input.video_codec_ctx, nullptr);
+        }
+        else if (packet->stream_index != input.video_stream_index) {
+            // Demuxers may still return packets of discarded streams
+            av_packet_unref(packet);
+            continue;
+        }
+        else {
+            ret = avcodec_send_packet(input.video_codec_ctx, packet);
+            av_packet_unref(packet);
+        }
+
+        if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+            cerr << "Error when sending video packet." << endl;
+            close_video_input(&input);
+            return SEND_VIDEO_PACKET_ERROR;
+        }
+
+        while ((ret = avcodec_receive_frame(input.video_codec_ctx, frame)) >= 0) {
+            if ((ret = detector.analyze(frame, &score)) < 0) {
+                close_video_input(&input);
+                return ret;
+            }
+
+            int64_t timestamp = frame->best_effort_timestamp;
+            if (timestamp != AV_NOPTS_VALUE) {
+                if (first_timestamp == AV_NOPTS_VALUE) first_timestamp = timestamp;
+                last_timestamp = timestamp;
+            }
+
+            if (score.is_cut) {
+                double seconds = timestamp != AV_NOPTS_VALUE ? timestamp * av_q2d(input.video_stream->time_base) : 0.0;
+                cout << "Scene " << scene_count << " at " << seconds << " s (frame " << frame_count << ", histogram "
+                     << score.histogram_distance << ", sad " << score.mean_abs_diff << ")" << endl;
+
+                if (encoder && (ret = encoder->submit(frame, format_output_path(pattern, scene_count))) < 0) {
+                    close_video_input(&input);
+                    return ret;
+                }
+                scene_count++;
+            }
+
+            frame_count++;
+            av_frame_unref(frame);
+        }
+
+        if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+            cerr << "Error when receive video frame." << endl;
+            close_video_input(&input);
+            return SEND_VIDEO_FRAME_ERROR;
+        }
+    }
+
+    double elapsed = (double)(av_gettime_relative() - started) / AV_TIME_BASE;
+    double duration = first_timestamp != AV_NOPTS_VALUE
+                      ? (last_timestamp - first_timestamp) * av_q2d(input.video_stream->time_base) : 0.0;
+
+    cout << "Found " << scene_count << " scenes in " << frame_count << " frames in " << elapsed << " s ("
+         << (elapsed > 0 ? frame_count / elapsed : 0.0) << " fps, " << (elapsed > 0 ? duration / elapsed : 0.0)
+         << "x realtime)." << endl;
+
+    close_video_input(&input);
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    return 0;
+}
+
+/**
+ * Input demuxed by one thread of the I/O benchmark.
+ */
+struct IO_BENCHMARK_JOB {
+    string path;
+    string mode;                    // "file", "mmap", "memory" or read through "io_service"
+    IO_SERVICE *io_service;
+    const vector<uint8_t> *memory;  // Input loaded once for every "memory" job
+    int64_t bytes;
+    long packets;
+    int error;
+};
+
+/**
+ * Thread function demuxing whole input of a job, packets are dropped.
+ */
+int run_io_benchmark_job(void *userdata) {
+    auto *job = (IO_BENCHMARK_JOB*)userdata;
+    AVFormatContext *format_ctx = avformat_alloc_context();
+    AVPacket *packet = av_packet_alloc();
+    MMAP_INPUT mmap_input;
+    URING_INPUT uring_input(job->io_service);
+    MEMORY_INPUT memory_input;
+
+    if (format_ctx == nullptr || packet == nullptr) {
+        avformat_free_context(format_ctx);
+        av_packet_free(&packet);
+        job->error = ALLOC_PACKET_ERROR;
+        return 0;
+    }
+
+    if (job->mode == "mmap") mmap_input.attach(job->path, format_ctx);
+    else if (job->memory) memory_input.attach(job->memory->data(), (int64_t)job->memory->size(), format_ctx);
+    else if (job->io_service) uring_input.attach(job->path, format_ctx);
+
+    if (avformat_open_input(&format_ctx, job->path.data(), nullptr, nullptr) < 0) {
+        av_packet_free(&packet);
+        job->error = OPEN_INPUT_ERROR;
+        return 0;
+    }
+
+    while (av_read_frame(format_ctx, packet) >= 0) {
+        job->bytes += packet->size;
+        job->packets++;
+        av_packet_unref(packet);
+    }
+
+    avformat_close_input(&format_ctx);
+    av_packet_free(&packet);
+    return 0;
+}
+
+/**
+ * Demux the same input on many threads at once with each input backend and print throughput.
+ *
+ * @note Every thread has its own demuxer, like GOP workers or batch jobs. "pread" and "uring" share one IO_SERVICE
+ *       between all demuxers, so the difference between them is only how reads reach the kernel. "memory" load input
+ *       once before timing, it is the cost of demuxing alone.
+ *
+ * @param path path of input file.
+ * @param demuxer_count number of concurrent demuxers.
+ * @return 0 on success or negative error code on failure.
+ */
+int benchmark_io(const string &path, int demuxer_count) {
+    const char *modes[] = {"memory", "file", "mmap", "pread", "uring"};
+    vector<uint8_t> memory;
+    FILE *file = fopen(path.data(), "rb");
+    uint8_t chunk[64 * 1024];
+    size_t read_size;
+
+    if (file == nullptr) {
+        cerr << "Can't open input file with given path." << endl;
+        return OPEN_INPUT_ERROR;
+    }
+    while ((read_size = fread(chunk, 1, sizeof(chunk), file)) > 0) memory.insert(memory.end(), chunk, chunk + read_size);
+    fclose(file);
+
+    for (auto mode : modes) {
+        IO_SERVICE io_service;
+        bool use_service = strcmp(mode, "pread") == 0 || strcmp(mode, "uring") == 0;
+        int ret = 0;
+
+        if (use_service && (ret = io_service.start(strcmp(mode, "uring") == 0)) < 0) return ret;
+        if (strcmp(mode, "uring") == 0 && !io_service.is_uring()) {
+            cout << "uring: io_uring is not available, skipped." << endl;
+            continue;
+        }
+
+        vector<IO_BENCHMARK_JOB> jobs(demuxer_count, {path, mode, use_service ? &io_service : nullptr,
+                                                        strcmp(mode, "memory") == 0 ? &memory : nullptr, 0, 0, 0});
+        vector<SDL_Thread*> threads;
+        int64_t started = av_gettime_relative();
+
+        for (auto &job : jobs) {
+            SDL_Thread *thread = SDL_CreateThread(run_io_benchmark_job, "io-benchmark", &job);
+            if (thread == nullptr) {
+                cerr << "Can't create benchmark thread with error: " << SDL_GetError() << endl;
+                ret = CREATE_IO_THREAD_ERROR;
+                break;
+            }
+            threads.push_back(thread);
+        }
+        for (auto thread : threads) SDL_WaitThread(thread, nullptr);
+        if (ret < 0) return ret;
+
+        double elapsed = (double)(av_gettime_relative() - started) / AV_TIME_BASE;
+        int64_t bytes = 0;
+        long packets = 0;
+        for (auto &job : jobs) {
+            if (job.error < 0) return job.error;
+            bytes += job.bytes;
+            packets += job.packets;
+        }
+
+        double megabytes = (double)bytes / (1024 * 1024);
+        cout << mode << ": " << demuxer_count << " demuxers, " << packets << " packets, " << megabytes << " MB in "
+             << elapsed << " s (" << (elapsed > 0 ? megabytes / elapsed : 0.0) << " MB/s";
+        if (use_service) cout << ", " << io_service.read_count() << " reads";
+        if (strcmp(mode, "uring") == 0 && !io_service.is_uring()) cout << ", io_uring failed and fell back to pread";
+        cout << ")." << endl;
+    }
+
+    return 0;
+}
+
+/**
+ * Decode every video listed in a text file on one pool of workers and print aggregate throughput.
+ * @param list_path text file with one input path per line, empty lines are skipped.
+ * @param files_in_flight number of files open at once, 0 let the batch decoder choose.
+ * @param io_service I/O thread serving reads of every file, nullptr to read with file protocol.
+ * @param stream_info_cache cache of stream info shared by files, nullptr to always probe.
+ * @return 0 on success or negative error code on failure.
+ */
+int decode_batch(const string &list_path, int files_in_flight, IO_SERVICE *io_service, STREAM_INFO_CACHE *stream_info_cache) {
+    vector<string> paths;
+    FILE *file = fopen(list_path.data(), "r");
+    char line[4096];
+
+    if (file == nullptr) {
+        cerr << "Can't open batch list: " << list_path << endl;
+        return READ_BATCH_LIST_ERROR;
+    }
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        string path = line;
+        while (!path.empty() && (path.back() == '\n' || path.back() == '\r')) path.pop_back();
+        if (!path.empty()) paths.push_back(path);
+    }
     fclose(file);
+
+    BATCH_DECODER batch(paths, SDL_GetCPUCount(), io_service, stream_info_cache);
+    int ret = batch.run(files_in_flight);
+    if (ret < 0) return ret;
+
+    for (auto &result : batch.file_results()) {
+        if (result.error < 0) cerr << "Can't decode " << result.path << " (error " << result.error << ")." << endl;
+    }
+    batch.report();
+
+    return 0;
+}
+
+/**
+ * Read every packet of input without decoding and write per stream statistics as JSON.
+ * @param format_ctx opened input, stream info is not needed and no stream discarded.
+ * @param path path of input, written in JSON.
+ * @param output_path JSON file to write, empty for standard output.
+ * @return 0 on success or error code on failure, "INCOMPLETE_SCAN_ERROR" when a read error stopped scan early (JSON
+ *         is still written with "complete" set to false).
+ */
+int scan_packets(AVFormatContext *format_ctx, const string &path, const string &output_path) {
+    PACKET_SCANNER scanner(format_ctx);
+    int ret = scanner.run();
+    if (ret < 0) return ret;
+
+    FILE *output = output_path.empty() ? stdout : fopen(output_path.data(), "w");
+    if (output == nullptr) {
+        cerr << "Can't open scan output: " << output_path << endl;
+        return WRITE_SCAN_ERROR;
+    }
+
+    scanner.write_json(output, path);
+    bool failed = ferror(output) != 0;
+    if (output != stdout) failed = fclose(output) != 0 || failed;
+    else fflush(output);
+
+    if (failed) {
+        cerr << "Can't write scan output." << endl;
+        return WRITE_SCAN_ERROR;
+    }
+    return scanner.complete() ? 0 : INCOMPLETE_SCAN_ERROR;
+}
+
+/**
+ * Choose biggest lowres factor of decoder which still produce frame not smaller than output image.
+ * @param codec video decoder.
+ * @param src_width width of coded frame.
+ * @param src_height height of coded frame.
+ * @param width width of output image.
+ * @param height height of output image.
+ * @return lowres factor, 0 when decoder does not support lowres decoding.
+ */
+int choose_lowres(const AVCodec *codec, int src_width, int src_height, int width, int height) {
+    int lowres = 0;
+
+    while (lowres < codec->max_lowres
+           && (src_width >> (lowres + 1)) >= width
+           && (src_height >> (lowres + 1)) >= height) {
+        lowres++;
+    }
+
+    return lowres;
 }
 
 int main(int argc, char *args[]) {
+    int64_t                 launched                = av_gettime_relative();
     int                     ret                     = 0;
     int                     selected_frame_index    = 343;
     int                     frame_count             = 0;
-    bool                    quit                    = false;
+    int                     seek_count              = 0;
     AVFormatContext         *format_ctx             = nullptr;
     string                  file_path               = "../../videos/video.flv";
+    IO_SERVICE              io_service;
+    IO_SERVICE              *shared_io              = nullptr;
+    MMAP_INPUT              mmap_input;
+    URING_INPUT             uring_input(&io_service);
+    MEMORY_INPUT            memory_input;
+    string                  shm_name;
+    string                  io_mode                 = "mmap";
+    bool                    io_benchmark            = false;
+    string                  batch_list;
+    int                     batch_in_flight         = 0;
+    bool                    scan                    = false;
+    string                  scan_output;
+    PROBE_SETTINGS          probe_settings          = {0, 0};
+    STREAM_INFO_CACHE       stream_info_cache;
+    STREAM_INFO_CACHE       *shared_stream_info     = nullptr;
+    bool                    stream_info_cached      = false;
+    int64_t                 stream_info_time        = 0;
+    bool                    first_frame_reported    = false;
     int                     video_stream_index      = -1;
     int                     audio_stream_index      = -1;
     AVStream                *video_stream           = nullptr;
-    AVStream                *audio_stream           = nullptr;
     AVCodecParameters       *video_codec_params     = nullptr;
-    AVCodecParameters       *audio_codec_params     = nullptr;
     const AVCodec           *video_codec            = nullptr;
-    const AVCodec           *audio_codec            = nullptr;
     AVCodecContext          *video_codec_ctx        = nullptr;
-    AVCodecContext          *audio_codec_ctx        = nullptr;
     AVPacket                *packet                 = nullptr;
     AVFrame                 *frame                  = nullptr;
-    SwsContext              *sws_ctx                = nullptr;
-    uint8_t                 *rgb_frame[4]           = {nullptr};
-    int                     rgb_frame_linesize[4]   = {0};
+    AVRational              frame_rate              = {0, 1};
+    vector<FRAME_TARGET>    targets;
+    size_t                  next_target             = 0;
+    size_t                  sought_end              = 0;        // Targets before this one were sought by last seek
+    int                     planned_packets         = 0;
+    int                     sent_since_seek         = 0;
+    bool                    drained                 = false;
+    int64_t                 position                = AV_NOPTS_VALUE;
+    bool                    eof                     = false;
+    bool                    contact_sheet           = false;
+    string                  output_pattern;
+    bool                    gop_parallel            = false;
+    ENCODE_SETTINGS         encode_settings         = {0, -1, false, 0, 0};
+    bool                    use_frame_index         = false;
+    bool                    scenes                  = false;
+    vector<int64_t>         at_timestamps;
+    FRAME_INDEX             frame_index;
 
     // Alloc format context for store data inside input file
     if ((format_ctx = avformat_alloc_context()) == nullptr) {
@@ -53,89 +529,220 @@ int main(int argc, char *args[]) {
         return ALLOC_FMT_CTX_ERROR;
     }
 
-    // Open input file and store data in format_ctx
-    if ((avformat_open_input(&format_ctx, file_path.data(), nullptr, nullptr)) < 0) {
-        cerr << "Can't open input file with given path." << endl;
-        return OPEN_INPUT_ERROR;
+    /*
+     * "--io=MODE" choose how input is read: "mmap" (default) map local file, "file" use the file protocol, "pread" and
+     * "uring" read through a shared I/O service, also used by the extra demuxers of "--gop-parallel" and "--scenes",
+     * "memory" load whole input before demuxing. "--shm=NAME" read media from shared-memory segment NAME, input path
+     * then only hint the container format. "--io-benchmark" demux the input on one thread per core with every mode and
+     * compare throughput. "--probesize=BYTES" and "--analyzeduration=US" limit how much input is probed for stream
+     * info, "--stream-info-cache" keep probed stream info in "<input>.sinfo" so next openings skip probing.
+     * "--batch=LIST" decode every video listed in text file LIST (one path per line) on one worker per core instead,
+     * "--batch-in-flight=N" set how many files are open at once. "--scan" only demux input and write packet statistics
+     * of every stream as JSON, to standard output or to file PATH with "--scan-output=PATH".
+     */
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(args[i], "--io=", 5) == 0) io_mode = args[i] + 5;
+        if (strncmp(args[i], "--shm=", 6) == 0) shm_name = args[i] + 6;
+        if (strncmp(args[i], "--probesize=", 12) == 0) probe_settings.probesize = atoll(args[i] + 12);
+        if (strncmp(args[i], "--analyzeduration=", 18) == 0) probe_settings.analyze_duration = atoll(args[i] + 18);
+        if (strcmp(args[i], "--stream-info-cache") == 0) {
+            stream_info_cache.enable();
+            shared_stream_info = &stream_info_cache;
+        }
+        if (strcmp(args[i], "--io-benchmark") == 0) io_benchmark = true;
+        if (strncmp(args[i], "--batch=", 8) == 0) batch_list = args[i] + 8;
+        if (strncmp(args[i], "--batch-in-flight=", 18) == 0) batch_in_flight = max(0, atoi(args[i] + 18));
+        if (strcmp(args[i], "--scan") == 0) scan = true;
+        if (strncmp(args[i], "--scan-output=", 14) == 0) scan_output = args[i] + 14;
+    }
+
+    if (io_mode != "mmap" && io_mode != "file" && io_mode != "pread" && io_mode != "uring" && io_mode != "memory") {
+        cerr << "Invalid I/O mode: " << io_mode << endl;
+        return INVALID_IO_MODE_ERROR;
+    }
+
+    if (io_benchmark) {
+        avformat_free_context(format_ctx);
+        return benchmark_io(file_path, SDL_GetCPUCount());
+    }
+
+    if (io_mode == "pread" || io_mode == "uring") {
+        if ((ret = io_service.start(io_mode == "uring")) < 0) return ret;
+        if (io_mode == "uring" && !io_service.is_uring()) cerr << "io_uring is not available, reads use pread." << endl;
+        shared_io = &io_service;
     }
 
-    // Find stream info in input file
-    if ((avformat_find_stream_info(format_ctx, nullptr)) < 0) {
-        cerr << "Can't find stream info." << endl;
-        return FIND_STREAM_INFO_ERROR;
+    if (!batch_list.empty()) {
+        avformat_free_context(format_ctx);
+        return decode_batch(batch_list, batch_in_flight, shared_io, shared_stream_info);
     }
 
-    // Find audio and video stream
-    for (int i = 0; i < format_ctx->nb_streams; ++i) {
-        if (format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-            video_stream_index  = i;
-            video_stream        = format_ctx->streams[i];
-            video_codec_params  = format_ctx->streams[i]->codecpar;
+    // Local files are read by the chosen backend, anything else (URL, pipe) fall back to the file protocol
+    if (!shm_name.empty()) {
+        if (!memory_input.attach_shared_memory(shm_name, format_ctx)) {
+            cerr << "Can't map shared memory: " << shm_name << endl;
+            return OPEN_INPUT_ERROR;
         }
-        if (format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-            audio_stream_index  = i;
-            audio_stream        = format_ctx->streams[i];
-            audio_codec_params  = format_ctx->streams[i]->codecpar;
+
+        // Input path only hint the format, cache entry of that path would describe other media
+        stream_info_cache.disable();
+    }
+    else if (io_mode == "memory") {
+        if (!memory_input.load_file(file_path, format_ctx)) {
+            cerr << "Can't load input file in memory." << endl;
+            return OPEN_INPUT_ERROR;
         }
     }
+    else if (shared_io) uring_input.attach(file_path, format_ctx);
+    else if (io_mode == "mmap") mmap_input.attach(file_path, format_ctx);
+
+    apply_probe_settings(format_ctx, probe_settings);
+
+    // Open input file and store data in format_ctx
+    if ((avformat_open_input(&format_ctx, file_path.data(), nullptr, nullptr)) < 0) {
+        cerr << "Can't open input file with given path." << endl;
+        return OPEN_INPUT_ERROR;
+    }
 
-    /* Check for sure we found video and audio stream */
-    if (video_stream_index < 0) {
-        cerr << "Can't find video stream." << endl;
-        return VIDEO_STREAM_NOT_FOUND;
+    // Scanning keep every stream and decode nothing, so stream info is not probed (it would open decoders and decode)
+    if (scan) {
+        ret = scan_packets(format_ctx, file_path, scan_output);
+        avformat_close_input(&format_ctx);
+        return ret;
     }
 
-    if (audio_stream_index < 0) {
-        cerr << "Can't find audio stream." << endl;
-        return AUDIO_STREAM_NOT_FOUND;
+    // Find stream info in input file, from cache when "--stream-info-cache" already probed it
+    stream_info_time = av_gettime_relative();
+    if ((ret = stream_info_cache.find_stream_info(format_ctx, file_path, &stream_info_cached)) < 0) return ret;
+    stream_info_time = av_gettime_relative() - stream_info_time;
+
+    /* Time to first frame count from launch, so opening and probing input are included */
+    auto report_first_frame = [&]() {
+        if (first_frame_reported) return;
+        first_frame_reported = true;
+        cout << "Time to first frame: " << (double)(av_gettime_relative() - launched) / 1000 << " ms (stream info "
+             << (stream_info_cached ? "from cache" : "probed") << " in " << (double)stream_info_time / 1000 << " ms)."
+             << endl;
+    };
+
+    // Only video is extracted, demuxer discard audio and every other stream so their packets are never read
+    if ((ret = select_streams(format_ctx, STREAM_SELECT_VIDEO_ONLY, &video_stream_index, &audio_stream_index)) < 0) return ret;
+    video_stream        = format_ctx->streams[video_stream_index];
+    video_codec_params  = video_stream->codecpar;
+
+    frame_rate = av_guess_frame_rate(format_ctx, video_stream, nullptr);
+    if (frame_rate.num <= 0 || frame_rate.den <= 0) frame_rate = {25, 1};
+
+    /*
+     * Frames to extract are given on command line as frame index ("343") or seconds ("12.5s"), "--contact-sheet"
+     * make a keyframe contact sheet instead. "--output=PATTERN" set output path where "%d" is replaced by frame index
+     * (".rgb" or ".raw" extension write raw RGB24, ".png", ".jpg", ".webp", ".bmp" and ".tiff" are encoded by
+     * libavcodec), "--mmap-output" write raw images through a mapping of output file. "--quality=1..100" set quality
+     * of JPEG and WebP, "--compression=N" set compression level of PNG (0 to 9) and WebP method (0 to 6).
+     * "--frame-index" use a persistent frame index stored next to input, so frame numbers map to exact timestamps.
+     * "--scenes" print scene changes, with "--output" first frame of each scene is saved too. "--at=TIME" get the first
+     * frame at or after TIME ("12.5" seconds or "900000pts" in stream time base) with one seek each. "--width=N" and
+     * "--height=N" downscale output images, a missing side follow aspect ratio.
+     */
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(args[i], "--contact-sheet") == 0) {
+            contact_sheet = true;
+            continue;
+        }
+        if (strncmp(args[i], "--output=", 9) == 0) {
+            output_pattern = args[i] + 9;
+            continue;
+        }
+        if (strcmp(args[i], "--mmap-output") == 0) {
+            encode_settings.mmap_output = true;
+            continue;
+        }
+        if (strncmp(args[i], "--quality=", 10) == 0) {
+            encode_settings.quality = max(1, min(100, atoi(args[i] + 10)));
+            continue;
+        }
+        if (strncmp(args[i], "--compression=", 14) == 0) {
+            encode_settings.compression_level = max(0, atoi(args[i] + 14));
+            continue;
+        }
+        if (strncmp(args[i], "--width=", 8) == 0) {
+            encode_settings.width = max(0, atoi(args[i] + 8));
+            continue;
+        }
+        if (strncmp(args[i], "--height=", 9) == 0) {
+            encode_settings.height = max(0, atoi(args[i] + 9));
+            continue;
+        }
+        if (strcmp(args[i], "--frame-index") == 0) {
+            use_frame_index = true;
+            continue;
+        }
+        if (strncmp(args[i], "--at=", 5) == 0) {
+            int64_t timestamp = 0;
+            if (!parse_timestamp(args[i] + 5, video_stream, &timestamp)) {
+                cerr << "Invalid time: " << args[i] + 5 << endl;
+                return INVALID_FRAME_TARGET_ERROR;
+            }
+            at_timestamps.push_back(timestamp);
+            continue;
+        }
+        if (strcmp(args[i], "--scenes") == 0) {
+            scenes = true;
+            continue;
+        }
+        if (strcmp(args[i], "--gop-parallel") == 0) {
+            gop_parallel = true;
+            continue;
+        }
+        if (strncmp(args[i], "--io=", 5) == 0 || strncmp(args[i], "--shm=", 6) == 0) continue;
+        if (strncmp(args[i], "--probesize=", 12) == 0 || strncmp(args[i], "--analyzeduration=", 18) == 0) continue;
+        if (strcmp(args[i], "--stream-info-cache") == 0 || strcmp(args[i], "--io-benchmark") == 0) continue;
+        if (strncmp(args[i], "--batch=", 8) == 0 || strncmp(args[i], "--batch-in-flight=", 18) == 0) continue;
+        if (strcmp(args[i], "--scan") == 0 || strncmp(args[i], "--scan-output=", 14) == 0) continue;
+
+        FRAME_TARGET target = {};
+        if (!parse_frame_target(args[i], video_stream, frame_rate, &target)) {
+            cerr << "Invalid frame target: " << args[i] << endl;
+            return INVALID_FRAME_TARGET_ERROR;
+        }
+        targets.push_back(target);
     }
 
-    /* Find video and audio decoder */
+    /* Find video decoder, no audio decoder is opened */
     video_codec = avcodec_find_decoder(video_codec_params->codec_id);
     if (video_codec == nullptr) {
         cerr << "Can't find decoder for video with codec: " << avcodec_get_name(video_codec_params->codec_id) << endl;
         return FIND_VIDEO_DECODER_ERROR;
     }
 
-    audio_codec = avcodec_find_decoder(audio_codec_params->codec_id);
-    if (audio_codec == nullptr) {
-        cerr << "Can't find decoder for audio with codec: " << avcodec_get_name(audio_codec_params->codec_id) << endl;
-        return FIND_AUDIO_DECODER_ERROR;
-    }
-
-    /* Set update video and audio codec context */
+    /* Set update video codec context */
     if ((video_codec_ctx = avcodec_alloc_context3(video_codec)) == nullptr) {
         cerr << "Can't alloc video codec context." << endl;
         return ALLOC_VIDEO_CODEC_CTX_ERROR;
     }
 
-    if ((audio_codec_ctx = avcodec_alloc_context3(audio_codec)) == nullptr) {
-        cerr << "Can't alloc audio codec context." << endl;
-        return ALLOC_AUDIO_CODEC_CTX_ERROR;
-    }
-
-    /* Copy video and audio codec params to context */
+    /* Copy video codec params to context */
     if ((avcodec_parameters_to_context(video_codec_ctx, video_codec_params)) < 0) {
         cerr << "Can't copy video codec params to video codec context." << endl;
         return COPY_VIDEO_CODEC_PARAMS_ERROR;
     }
 
-    if ((avcodec_parameters_to_context(audio_codec_ctx, audio_codec_params)) < 0) {
-        cerr << "Can't copy audio codec params to audio codec context." << endl;
-        return COPY_AUDIO_CODEC_PARAMS_ERROR;
+    /* Downscaled output let decoder skip resolution we would throw away, sws then only finish the job */
+    if (encode_settings.width > 0 || encode_settings.height > 0) {
+        int output_width = 0, output_height = 0;
+        output_image_size(video_codec_params->width, video_codec_params->height, encode_settings.width,
+                          encode_settings.height, &output_width, &output_height);
+
+        video_codec_ctx->lowres = choose_lowres(video_codec, video_codec_params->width, video_codec_params->height,
+                                                output_width, output_height);
     }
 
-    /* Now we need open video and audio codec for ready to read and decode video and audio packet */
+    /* Now we need open video codec for ready to read and decode video packet */
     if (avcodec_open2(video_codec_ctx, video_codec, nullptr) < 0) {
         cerr << "Can't open video codec context." << endl;
         return OPEN_VIDEO_CODEC_ERROR;
     }
 
-    if (avcodec_open2(audio_codec_ctx, audio_codec, nullptr) < 0) {
-        cerr << "Can't open audio codec context." << endl;
-        return OPEN_AUDIO_CODEC_ERROR;
-    }
-
     /* Alloc packet for read packet from input file and frame for receive frame decoded from packet */
     if ((packet = av_packet_alloc()) == nullptr) {
         cerr << "Can't alloc packet." << endl;
@@ -147,78 +754,207 @@ int main(int argc, char *args[]) {
         return ALLOC_FRAME_ERROR;
     }
 
-    /* Get SwsContext for scaling and converting frame data */
-    sws_ctx = sws_getContext(video_codec_ctx->width, video_codec_ctx->height, video_codec_ctx->pix_fmt,
-                             video_codec_ctx->width, video_codec_ctx->height, AV_PIX_FMT_RGB24,
-                             SWS_BILINEAR, nullptr, nullptr, nullptr);
-    if (sws_ctx == nullptr) {
-        cerr << "Can't get sws context." << endl;
-        return GET_SWS_CTX_ERROR;
+    bool save_scenes = !output_pattern.empty();
+    if (output_pattern.empty()) output_pattern = contact_sheet ? "contact-sheet.ppm" : "frame-%d.ppm";
+
+    /* Frames are converted, encoded and written on worker threads while decoding go on */
+    IMAGE_ENCODE_POOL encoder(encode_settings);
+    if ((ret = encoder.start(SDL_GetCPUCount())) < 0) return ret;
+
+    /* "--gop-parallel" decode the whole file with one decoder per core, each working on its own keyframe segments */
+    if (gop_parallel) {
+        GOP_PARALLEL_DECODER gop_decoder(file_path, SDL_GetCPUCount(), shared_io, shared_stream_info);
+        GOP_PASS_STATS stats = {0, 0, AV_NOPTS_VALUE};
+        int64_t started = av_gettime_relative();
+
+        if ((ret = gop_decoder.run(count_gop_frame, &stats)) < 0) return ret;
+
+        double elapsed = (double)(av_gettime_relative() - started) / AV_TIME_BASE;
+        cout << "Decoded " << stats.frames << " frames from " << gop_decoder.keyframe_count() << " keyframes in "
+             << gop_decoder.segment_count() << " segments on " << SDL_GetCPUCount() << " threads in " << elapsed
+             << " s (" << (elapsed > 0 ? stats.frames / elapsed : 0.0) << " fps), " << stats.out_of_order
+             << " frames out of order." << endl;
+
+        targets.clear();
     }
+    else if (!at_timestamps.empty()) {
+        /* Each time is reached independently, work for each is bounded by the GOP which contain it */
+        for (auto timestamp : at_timestamps) {
+            int decoded = 0;
+
+            ret = decode_frame_at(format_ctx, video_codec_ctx, video_stream_index, timestamp, packet, frame, &decoded);
+            if (ret == AVERROR_EOF) {
+                cerr << "No frame at or after " << timestamp * av_q2d(video_stream->time_base) << " s." << endl;
+                continue;
+            }
+            if (ret < 0) return ret;
+            report_first_frame();
+
+            int64_t index = timestamp_to_frame_index(video_stream, frame_rate, frame->best_effort_timestamp != AV_NOPTS_VALUE
+                                                                              ? frame->best_effort_timestamp : timestamp);
+            cout << "Frame at " << timestamp * av_q2d(video_stream->time_base) << " s has pts "
+                 << frame->best_effort_timestamp << ", decoded " << decoded << " frames." << endl;
+
+            ret = encoder.submit(frame, format_output_path(output_pattern, index));
+            av_frame_unref(frame);
+            if (ret < 0) return ret;
+        }
 
-    /* Alloc memory for store rgb data */
-    ret = av_image_alloc(rgb_frame, rgb_frame_linesize, video_codec_ctx->width, video_codec_ctx->height, AV_PIX_FMT_RGB24, 1);
-    if (ret < 0) {
-        cerr << "Can't alloc memory for RGB frame" << endl;
-        return ALLOC_RGB_FRAME_ERROR;
+        targets.clear();
     }
+    else if (scenes) {
+        if ((ret = detect_scenes(file_path, save_scenes ? &encoder : nullptr, output_pattern, shared_io, shared_stream_info)) < 0) return ret;
 
-    // Read packet and decode into frame
-    while (av_read_frame(format_ctx, packet) >= 0) {
-        if (quit) break;
+        targets.clear();
+    }
+    else if (contact_sheet) {
+        ret = make_contact_sheet(format_ctx, video_codec_ctx, video_stream_index, &encoder, format_output_path(output_pattern, 0));
+        if (ret < 0) return ret;
 
-        if (packet->stream_index == video_stream_index) {
-            ret = avcodec_send_packet(video_codec_ctx, packet);
+        targets.clear();
+    }
+    else if (targets.empty()) {
+        targets.push_back({frame_index_to_timestamp(video_stream, frame_rate, selected_frame_index), selected_frame_index, true,
+                           AV_NOPTS_VALUE, 0});
+    }
+
+    /* Frame index give exact timestamp of each frame number, even with variable frame rate */
+    if (use_frame_index && !targets.empty()) {
+        int64_t started = av_gettime_relative();
+        if ((ret = frame_index.open(file_path, video_stream_index)) < 0) return ret;
+
+        cout << "Frame index with " << frame_index.size() << " frames " << (frame_index.is_from_sidecar() ? "loaded" : "built")
+             << " in " << (av_gettime_relative() - started) / 1000 << " ms." << endl;
 
-            if (ret == AVERROR_EOF) break;
+        for (auto &target : targets) {
+            FRAME_SEEK_PLAN plan = {};
+            if (!target.by_index || !frame_index.lookup(target.index, &plan)) continue;
 
-            if (ret < 0 && ret != AVERROR(EAGAIN)) {
-                cerr << "Error when sending video packet." << endl;
-                return SEND_VIDEO_PACKET_ERROR;
+            target.timestamp        = plan.timestamp;
+            target.seek_timestamp   = plan.seek_timestamp;
+            target.decode_count     = plan.decode_count;
+            cout << "Frame " << target.index << ": pts " << plan.timestamp << ", seek to keyframe " << plan.seek_timestamp
+                 << ", decode " << plan.decode_count << " packets." << endl;
+        }
+    }
+
+    auto seek_needed = [&](int64_t target) {
+        return frame_index.size() > 0 ? frame_index.should_seek(position, target) : should_seek(video_stream, position, target);
+    };
+
+    sort(targets.begin(), targets.end());
+
+    /*
+     * Satisfy every target in one pass in timestamp order. Before each target we seek to the keyframe before it when
+     * that skip work, otherwise we keep decoding straight through. Input that can't seek is decoded from the start.
+     * Targets from frame index seek to their exact keyframe and send only the packets index counted until the target,
+     * then drain decoder so it come out without reading further. Following targets with the same keyframe are in the
+     * same GOP, they share that seek and the drain waits for the furthest of them.
+     */
+    while (next_target < targets.size()) {
+        // A drained decoder can only continue after a seek
+        if (next_target >= sought_end && (drained || seek_needed(targets[next_target].timestamp))) {
+            const FRAME_TARGET &target = targets[next_target];
+            bool was_drained = drained;
+            sought_end      = next_target + 1;
+            drained         = false;
+            sent_since_seek = 0;
+            planned_packets = 0;
+
+            ret = target.decode_count > 0
+                  ? seek_to_keyframe(format_ctx, video_codec_ctx, video_stream_index, target.seek_timestamp)
+                  : seek_to_timestamp(format_ctx, video_codec_ctx, video_stream_index, target.timestamp);
+
+            for (size_t i = next_target; ret >= 0 && i < targets.size() && targets[i].decode_count > 0
+                                         && targets[i].seek_timestamp == target.seek_timestamp; ++i) {
+                planned_packets = max(planned_packets, targets[i].decode_count);
+                sought_end      = i + 1;
             }
 
-            while (ret >= 0) {
-                ret = avcodec_receive_frame(video_codec_ctx, frame);
+            if (ret < 0) {
+                cerr << "Can't seek input, decoding straight to frame " << target.index << "." << endl;
+                if (was_drained) avcodec_flush_buffers(video_codec_ctx);
+            }
+            else {
+                seek_count++;
+            }
+        }
 
-                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
-                else if (ret < 0) {
-                    cerr << "Error when receive video frame." << endl;
-                    return SEND_VIDEO_FRAME_ERROR;
-                }
+        // Read packet and send it to decoder, on end of file or once planned packets are sent send a null packet to
+        // drain frames left in decoder
+        bool plan_done = planned_packets > 0 && next_target < sought_end && sent_since_seek >= planned_packets;
+        if (plan_done || av_read_frame(format_ctx, packet) < 0) {
+            if (plan_done) drained = true;
+            else eof = true;
+
+            planned_packets = 0;
+            ret = avcodec_send_packet(video_codec_ctx, nullptr);
+        }
+        else if (packet->stream_index != video_stream_index) {
+            av_packet_unref(packet);
+            continue;
+        }
+        else {
+            ret = avcodec_send_packet(video_codec_ctx, packet);
+            av_packet_unref(packet);
+            sent_since_seek++;
+        }
+
+        if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+            cerr << "Error when sending video packet." << endl;
+            return SEND_VIDEO_PACKET_ERROR;
+        }
 
-                if (frame_count == selected_frame_index) {
-                    if (video_codec_ctx->pix_fmt != AV_PIX_FMT_RGB24) {
-                        /* Convert frame pixel format to RGB24 format */
-                        sws_scale(sws_ctx, frame->data, frame->linesize, 0, video_codec_ctx->height, rgb_frame, rgb_frame_linesize);
-                        save_frame(video_codec_ctx, rgb_frame, rgb_frame_linesize);
-                    }
-                    else {
-                        save_frame(video_codec_ctx, frame->data, frame->linesize);
-                    }
-
-                    quit = true;
-                    break;
+        while ((ret = avcodec_receive_frame(video_codec_ctx, frame)) >= 0) {
+            report_first_frame();
+
+            /* Position comes from frame timestamp, frames without timestamp fall back to decode order */
+            position = frame->best_effort_timestamp != AV_NOPTS_VALUE
+                       ? frame->best_effort_timestamp
+                       : frame_index_to_timestamp(video_stream, frame_rate, frame_count);
+            frame_count++;
+
+            for (; next_target < targets.size() && position >= targets[next_target].timestamp; ++next_target) {
+                // Frame index map frame number to an exact pts, any other frame mean index does not match input
+                if (targets[next_target].decode_count > 0 && position != targets[next_target].timestamp) {
+                    cerr << "Frame " << targets[next_target].index << ": decoded pts " << position << " instead of "
+                         << targets[next_target].timestamp << " from frame index." << endl;
                 }
 
-                frame_count++;
-                av_frame_unref(frame);
+                ret = encoder.submit(frame, format_output_path(output_pattern, targets[next_target].index));
+                if (ret < 0) return ret;
             }
 
-        }
+            av_frame_unref(frame);
 
-        if (packet->stream_index == audio_stream_index) {
+            // Frames left in decoder are dropped by the seek, once draining at end of file every frame left is kept
+            if (!eof && !drained && next_target < targets.size() && next_target >= sought_end
+                && seek_needed(targets[next_target].timestamp)) break;
+        }
 
+        if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+            cerr << "Error when receive video frame." << endl;
+            return SEND_VIDEO_FRAME_ERROR;
         }
 
-        av_packet_unref(packet);
+        if (eof) break;
+
+        // Target did not come out of the packets frame index counted, reach it with a seek by timestamp instead
+        if (drained && next_target < sought_end) {
+            cerr << "Frame " << targets[next_target].index << " not reached from frame index, seeking by timestamp." << endl;
+            for (size_t i = next_target; i < sought_end; ++i) targets[i].decode_count = 0;
+            sought_end = 0;
+        }
     }
 
+    if ((ret = encoder.finish()) < 0) return ret;
+
     av_frame_free(&frame);
     av_packet_free(&packet);
     avcodec_free_context(&video_codec_ctx);
-    avcodec_free_context(&audio_codec_ctx);
-    sws_freeContext(sws_ctx);
     avformat_free_context(format_ctx);
+    if (!contact_sheet && !gop_parallel && !scenes && at_timestamps.empty()) cout << "Extracted " << next_target << " of " << targets.size() << " frames, decoded " << frame_count
+         << " frames with " << seek_count << " seeks." << endl;
     cout << "COMPLETE" << endl;
 
     return 0;
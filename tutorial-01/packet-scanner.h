@@ -0,0 +1,327 @@
+#ifndef TUTORIAL_01_PACKET_SCANNER_H
+#define TUTORIAL_01_PACKET_SCANNER_H
+
+#include "iostream"
+#include "string"
+#include "vector"
+#include "cstdio"
+#include "algorithm"
+#include "error-code.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavutil/time.h"
+}
+
+// Width of each bitrate bucket, in seconds
+const double SCAN_BITRATE_INTERVAL = 1.0;
+
+// Buckets kept for each stream, packets past them (or before first dts) are only counted
+const size_t SCAN_MAX_BITRATE_BUCKETS = 24 * 3600;
+
+// A forward dts jump longer than this is a gap, in seconds
+const double SCAN_MAX_DTS_GAP = 1.0;
+
+// Discontinuities listed for each stream, others are only counted
+const size_t SCAN_MAX_LISTED_DISCONTINUITIES = 100;
+
+/**
+ * Place where timestamps of a stream do not follow each other.
+ */
+struct SCAN_DISCONTINUITY {
+    long packet;                // Index of packet in stream
+    double time;                // dts of packet, in seconds
+    double jump;                // Difference with previous dts, in seconds
+    const char *kind;           // "backward", "duplicate" or "gap"
+};
+
+/**
+ * Packet metadata gathered for one stream.
+ */
+struct STREAM_SCAN {
+    long packets;
+    int64_t bytes;
+    int min_size;
+    int max_size;
+    long corrupt_packets;
+    long missing_timestamps;
+    int64_t first_dts;
+    int64_t last_dts;
+    int64_t last_duration;
+    long keyframes;
+    long last_keyframe_packet;
+    double last_keyframe_time;
+    bool last_keyframe_timed;       // Last keyframe had a timestamp
+    long min_keyframe_interval;     // In packets
+    long max_keyframe_interval;
+    long total_keyframe_interval;
+    double min_keyframe_seconds;
+    double max_keyframe_seconds;
+    double total_keyframe_seconds;
+    long timed_keyframe_intervals;
+    long discontinuity_count;
+    long unbucketed_packets;
+    std::vector<int64_t> bucket_bytes;
+    std::vector<SCAN_DISCONTINUITY> discontinuities;
+};
+
+/**
+ * Read every packet of input without decoding and gather per stream statistics, written as JSON.
+ *
+ * @note Only av_read_frame run, no decoder is opened and every stream is kept, so scanning cost is demuxing plus a
+ *       few counters per packet and goes as fast as input can be read. Timestamps are checked on dts (pts when dts is
+ *       missing), which must grow inside a stream: going back, repeating or jumping forward more than
+ *       "SCAN_MAX_DTS_GAP" is a discontinuity. Containers flagged AVFMT_TS_DISCONT (MPEG-TS) are allowed to do so.
+ */
+struct PACKET_SCANNER {
+private:
+    AVFormatContext *format_ctx;
+    std::vector<STREAM_SCAN> streams;
+    long total_packets;
+    int64_t total_bytes;
+    double elapsed;
+    int read_error;                 // Error which stopped av_read_frame before end of input, 0 when scan is complete
+
+    static void write_string(FILE *output, const char *text) {
+        fputc('"', output);
+        for (const char *c = text; *c; ++c) {
+            if (*c == '"' || *c == '\\') fprintf(output, "\\%c", *c);
+            else if ((unsigned char)*c < 0x20) fprintf(output, "\\u%04x", (unsigned char)*c);
+            else fputc(*c, output);
+        }
+        fputc('"', output);
+    }
+
+    static STREAM_SCAN empty_scan() {
+        STREAM_SCAN scan = {};
+        scan.first_dts              = AV_NOPTS_VALUE;
+        scan.last_dts               = AV_NOPTS_VALUE;
+        scan.last_keyframe_packet   = -1;
+        scan.last_keyframe_time     = 0.0;
+        scan.last_keyframe_timed    = false;
+        return scan;
+    }
+
+    void add_packet(const AVPacket *packet) {
+        STREAM_SCAN *scan = &this->streams[packet->stream_index];
+        AVRational time_base = this->format_ctx->streams[packet->stream_index]->time_base;
+        int64_t dts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+        double time = dts != AV_NOPTS_VALUE ? (double)dts * av_q2d(time_base) : 0.0;
+        long index = scan->packets++;
+
+        scan->bytes += packet->size;
+        scan->min_size = index == 0 ? packet->size : std::min(scan->min_size, packet->size);
+        scan->max_size = std::max(scan->max_size, packet->size);
+        if (packet->flags & AV_PKT_FLAG_CORRUPT) scan->corrupt_packets++;
+
+        /* Timestamps */
+        if (dts == AV_NOPTS_VALUE) {
+            scan->missing_timestamps++;
+        }
+        else {
+            if (scan->last_dts != AV_NOPTS_VALUE) {
+                double jump = (double)(dts - scan->last_dts) * av_q2d(time_base);
+                const char *kind = dts < scan->last_dts ? "backward" : dts == scan->last_dts ? "duplicate"
+                                 : jump > SCAN_MAX_DTS_GAP ? "gap" : nullptr;
+
+                if (kind != nullptr) {
+                    scan->discontinuity_count++;
+                    if (scan->discontinuities.size() < SCAN_MAX_LISTED_DISCONTINUITIES) {
+                        scan->discontinuities.push_back({index, time, jump, kind});
+                    }
+                }
+            }
+            if (scan->first_dts == AV_NOPTS_VALUE) scan->first_dts = dts;
+            scan->last_dts      = dts;
+            scan->last_duration = packet->duration;
+        }
+
+        /* Bitrate, bytes are put in the bucket of their dts from first dts of stream */
+        double offset = dts != AV_NOPTS_VALUE ? (double)(dts - scan->first_dts) * av_q2d(time_base) : -1.0;
+        auto bucket = offset >= 0 ? (size_t)(offset / SCAN_BITRATE_INTERVAL) : SCAN_MAX_BITRATE_BUCKETS;
+        if (bucket < SCAN_MAX_BITRATE_BUCKETS) {
+            if (bucket >= scan->bucket_bytes.size()) scan->bucket_bytes.resize(bucket + 1, 0);
+            scan->bucket_bytes[bucket] += packet->size;
+        }
+        else {
+            scan->unbucketed_packets++;
+        }
+
+        /* Keyframe intervals, in packets of stream and in seconds */
+        if (packet->flags & AV_PKT_FLAG_KEY) {
+            if (scan->keyframes > 0) {
+                long interval = index - scan->last_keyframe_packet;
+                scan->min_keyframe_interval = scan->keyframes == 1 ? interval : std::min(scan->min_keyframe_interval, interval);
+                scan->max_keyframe_interval = std::max(scan->max_keyframe_interval, interval);
+                scan->total_keyframe_interval += interval;
+
+                if (dts != AV_NOPTS_VALUE && scan->last_keyframe_timed) {
+                    double seconds = time - scan->last_keyframe_time;
+                    scan->min_keyframe_seconds = scan->timed_keyframe_intervals == 0 ? seconds : std::min(scan->min_keyframe_seconds, seconds);
+                    scan->max_keyframe_seconds = std::max(scan->max_keyframe_seconds, seconds);
+                    scan->total_keyframe_seconds += seconds;
+                    scan->timed_keyframe_intervals++;
+                }
+            }
+            scan->keyframes++;
+            scan->last_keyframe_packet  = index;
+            scan->last_keyframe_time    = time;
+            scan->last_keyframe_timed   = dts != AV_NOPTS_VALUE;
+        }
+
+        this->total_packets++;
+        this->total_bytes += packet->size;
+    }
+
+    void write_stream(FILE *output, unsigned int stream_index) const {
+        const STREAM_SCAN &scan = this->streams[stream_index];
+        const AVStream *stream = this->format_ctx->streams[stream_index];
+        double time_base = av_q2d(stream->time_base);
+        const char *type = av_get_media_type_string(stream->codecpar->codec_type);
+        double duration = 0.0;
+
+        if (scan.first_dts != AV_NOPTS_VALUE) {
+            duration = (double)(scan.last_dts - scan.first_dts + scan.last_duration) * time_base;
+        }
+
+        fprintf(output, "    {\n      \"index\": %u,\n      \"type\": ", stream_index);
+        write_string(output, type ? type : "unknown");
+        fprintf(output, ",\n      \"codec\": ");
+        write_string(output, avcodec_get_name(stream->codecpar->codec_id));
+        fprintf(output, ",\n      \"time_base\": \"%d/%d\",\n", stream->time_base.num, stream->time_base.den);
+        fprintf(output, "      \"packets\": %ld,\n      \"bytes\": %lld,\n", scan.packets, (long long)scan.bytes);
+        fprintf(output, "      \"packet_size\": {\"min\": %d, \"max\": %d, \"average\": %.1f},\n", scan.min_size,
+                scan.max_size, scan.packets > 0 ? (double)scan.bytes / (double)scan.packets : 0.0);
+        fprintf(output, "      \"corrupt_packets\": %ld,\n      \"missing_timestamps\": %ld,\n", scan.corrupt_packets,
+                scan.missing_timestamps);
+        fprintf(output, "      \"duration\": %.6f,\n      \"average_bitrate\": %.0f,\n", duration,
+                duration > 0 ? (double)scan.bytes * 8 / duration : 0.0);
+
+        fprintf(output, "      \"keyframes\": {\"count\": %ld", scan.keyframes);
+        if (scan.keyframes > 1) {
+            fprintf(output, ", \"interval_packets\": {\"min\": %ld, \"max\": %ld, \"average\": %.1f}",
+                    scan.min_keyframe_interval, scan.max_keyframe_interval,
+                    (double)scan.total_keyframe_interval / (double)(scan.keyframes - 1));
+        }
+        if (scan.timed_keyframe_intervals > 0) {
+            fprintf(output, ", \"interval_seconds\": {\"min\": %.6f, \"max\": %.6f, \"average\": %.6f}",
+                    scan.min_keyframe_seconds, scan.max_keyframe_seconds,
+                    scan.total_keyframe_seconds / (double)scan.timed_keyframe_intervals);
+        }
+        fprintf(output, "},\n");
+
+        fprintf(output, "      \"bitrate\": {\"interval\": %.3f, \"unbucketed_packets\": %ld, \"bits_per_second\": [",
+                SCAN_BITRATE_INTERVAL, scan.unbucketed_packets);
+        for (size_t i = 0; i < scan.bucket_bytes.size(); ++i) {
+            fprintf(output, "%s%.0f", i > 0 ? ", " : "", (double)scan.bucket_bytes[i] * 8 / SCAN_BITRATE_INTERVAL);
+        }
+        fprintf(output, "]},\n");
+
+        fprintf(output, "      \"discontinuities\": {\"count\": %ld, \"listed\": [", scan.discontinuity_count);
+        for (size_t i = 0; i < scan.discontinuities.size(); ++i) {
+            const SCAN_DISCONTINUITY &discontinuity = scan.discontinuities[i];
+            fprintf(output, "%s\n        {\"packet\": %ld, \"time\": %.6f, \"jump\": %.6f, \"kind\": \"%s\"}",
+                    i > 0 ? "," : "", discontinuity.packet, discontinuity.time, discontinuity.jump, discontinuity.kind);
+        }
+        fprintf(output, "%s]}\n    }", scan.discontinuities.empty() ? "" : "\n      ");
+    }
+
+public:
+    /**
+     * @param format_ctx opened input, every stream is scanned so none should be discarded.
+     */
+    explicit PACKET_SCANNER(AVFormatContext *format_ctx) {
+        this->format_ctx    = format_ctx;
+        this->total_packets = 0;
+        this->total_bytes   = 0;
+        this->elapsed       = 0.0;
+        this->read_error    = 0;
+
+        this->streams.resize(format_ctx->nb_streams, empty_scan());
+    }
+
+    /**
+     * Read every packet of input.
+     * @return 0 on success or negative error code on failure.
+     * @note A read error stopping scan early is not a failure, statistics gathered so far are kept and "complete()"
+     *       tell it.
+     */
+    int run() {
+        int64_t started = av_gettime_relative();
+        AVPacket *packet = av_packet_alloc();
+        int ret = 0;
+
+        if (packet == nullptr) {
+            std::cerr << "Can't alloc packet." << std::endl;
+            return ALLOC_PACKET_ERROR;
+        }
+
+        while ((ret = av_read_frame(this->format_ctx, packet)) >= 0) {
+            // Streams can appear while reading (AVFMTCTX_NOHEADER), they start with empty statistics
+            if ((size_t)packet->stream_index >= this->streams.size()) {
+                this->streams.resize(this->format_ctx->nb_streams, empty_scan());
+            }
+
+            add_packet(packet);
+            av_packet_unref(packet);
+        }
+        av_packet_free(&packet);
+
+        this->elapsed = (double)(av_gettime_relative() - started) / AV_TIME_BASE;
+        if (ret != AVERROR_EOF) {
+            std::cerr << "Can't read packet from input, scan stopped early." << std::endl;
+            this->read_error = ret;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Whether every packet of input has been read.
+     */
+    bool complete() const {
+        return this->read_error == 0;
+    }
+
+    /**
+     * Write gathered statistics as JSON.
+     * @param output destination, stdout or an opened file.
+     * @param path path of input, written as is.
+     */
+    void write_json(FILE *output, const std::string &path) const {
+        int64_t input_bytes = this->format_ctx->pb ? avio_tell(this->format_ctx->pb) : 0;
+        double megabytes = (double)input_bytes / (1024 * 1024);
+
+        fprintf(output, "{\n  \"input\": ");
+        write_string(output, path.data());
+        fprintf(output, ",\n  \"format\": ");
+        write_string(output, this->format_ctx->iformat->name);
+        fprintf(output, ",\n  \"complete\": %s,\n", complete() ? "true" : "false");
+        if (!complete()) {
+            char error[AV_ERROR_MAX_STRING_SIZE] = {0};
+            av_strerror(this->read_error, error, sizeof(error));
+            fprintf(output, "  \"error\": ");
+            write_string(output, error);
+            fprintf(output, ",\n");
+        }
+        fprintf(output, "  \"timestamp_discontinuities_allowed\": %s,\n",
+                (this->format_ctx->iformat->flags & AVFMT_TS_DISCONT) ? "true" : "false");
+        fprintf(output, "  \"duration\": %.6f,\n", this->format_ctx->duration != AV_NOPTS_VALUE
+                                                     ? (double)this->format_ctx->duration / AV_TIME_BASE : 0.0);
+        fprintf(output, "  \"packets\": %ld,\n  \"packet_bytes\": %lld,\n  \"input_bytes\": %lld,\n",
+                this->total_packets, (long long)this->total_bytes, (long long)input_bytes);
+        fprintf(output, "  \"scan\": {\"seconds\": %.6f, \"packets_per_second\": %.0f, \"megabytes_per_second\": %.1f},\n",
+                this->elapsed, this->elapsed > 0 ? (double)this->total_packets / this->elapsed : 0.0,
+                this->elapsed > 0 ? megabytes / this->elapsed : 0.0);
+
+        fprintf(output, "  \"streams\": [");
+        for (unsigned int i = 0; i < this->streams.size(); ++i) {
+            fprintf(output, "%s\n", i > 0 ? "," : "");
+            write_stream(output, i);
+        }
+        fprintf(output, "\n  ]\n}\n");
+    }
+};
+
+#endif //TUTORIAL_01_PACKET_SCANNER_H
@@ -0,0 +1,184 @@
+#ifndef TUTORIAL_01_SCENE_DETECTOR_H
+#define TUTORIAL_01_SCENE_DETECTOR_H
+
+#include "iostream"
+#include "vector"
+#include "cstring"
+#include "cstdlib"
+#include "error-code.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+}
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include "emmintrin.h"
+#define SCENE_DETECTOR_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include "arm_neon.h"
+#define SCENE_DETECTOR_NEON
+#endif
+
+// Size of luma thumbnail compared between frames, width is a multiple of 16 for SIMD kernels
+const int SCENE_THUMB_WIDTH = 160;
+const int SCENE_THUMB_HEIGHT = 90;
+
+// Number of bins of luma histogram
+const int SCENE_HISTOGRAM_BINS = 64;
+
+// Histogram distance (0 to 1) above which frames may belong to different scenes
+const double SCENE_HISTOGRAM_THRESHOLD = 0.35;
+
+// Mean absolute luma difference (0 to 255) above which frames may belong to different scenes
+const double SCENE_SAD_THRESHOLD = 12.0;
+
+/**
+ * Sum of absolute differences of two byte arrays.
+ * @param a first array.
+ * @param b second array.
+ * @param size number of bytes, below 16 MB.
+ * @return sum of |a[i] - b[i]|.
+ */
+inline uint64_t sum_abs_diff(const uint8_t *a, const uint8_t *b, size_t size) {
+    uint64_t sum = 0;
+    size_t i = 0;
+
+#if defined(SCENE_DETECTOR_SSE2)
+    __m128i total = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        total = _mm_add_epi64(total, _mm_sad_epu8(va, vb));
+    }
+    // Each 64-bit lane hold a partial sum, low 32 bits are enough for thumbnails
+    sum = (uint32_t)_mm_cvtsi128_si32(total) + (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(total, 8));
+#elif defined(SCENE_DETECTOR_NEON)
+    uint32x4_t total = vdupq_n_u32(0);
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t diff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        total = vpadalq_u16(total, vpaddlq_u8(diff));
+    }
+    sum = (uint64_t)vgetq_lane_u32(total, 0) + vgetq_lane_u32(total, 1) + vgetq_lane_u32(total, 2) + vgetq_lane_u32(total, 3);
+#endif
+
+    for (; i < size; ++i) sum += (uint64_t)std::abs((int)a[i] - (int)b[i]);
+    return sum;
+}
+
+/**
+ * Result of comparing a frame with the previous one.
+ */
+struct SCENE_SCORE {
+    double histogram_distance;  // 0 same luma distribution, 1 nothing in common
+    double mean_abs_diff;       // Mean absolute luma difference per pixel, 0 to 255
+    bool is_cut;                // Frame start a new scene
+};
+
+/**
+ * Detect scene changes from a small luma thumbnail of each frame.
+ *
+ * @note Luma is sampled straight from the first plane of 8-bit YUV frames with 2x2 averaging, other formats are
+ *       converted to GRAY8 by sws_scale. A frame start a new scene when both histogram distance and mean absolute
+ *       difference with previous frame are above threshold, so motion alone (high SAD, same histogram) or a fade
+ *       (close histogram) are not cuts.
+ */
+struct SCENE_DETECTOR {
+private:
+    SwsContext *sws_ctx;
+    std::vector<uint8_t> thumbs[2];
+    uint32_t histograms[2][SCENE_HISTOGRAM_BINS];
+    int current;
+    long frames;
+
+    static bool has_8bit_luma_plane(AVPixelFormat format) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+        return desc && !(desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM))
+               && desc->comp[0].plane == 0 && desc->comp[0].depth == 8 && desc->comp[0].step == 1;
+    }
+
+    /**
+     * Sample luma of frame into "thumb".
+     */
+    int make_thumb(const AVFrame *frame, uint8_t *thumb) {
+        if (has_8bit_luma_plane((AVPixelFormat)frame->format) && frame->width >= SCENE_THUMB_WIDTH * 2
+            && frame->height >= SCENE_THUMB_HEIGHT * 2) {
+            for (int y = 0; y < SCENE_THUMB_HEIGHT; ++y) {
+                const uint8_t *row = frame->data[0] + (size_t)(y * frame->height / SCENE_THUMB_HEIGHT) * frame->linesize[0];
+                const uint8_t *next_row = row + frame->linesize[0];
+
+                for (int x = 0; x < SCENE_THUMB_WIDTH; ++x) {
+                    int sx = x * frame->width / SCENE_THUMB_WIDTH;
+                    thumb[y * SCENE_THUMB_WIDTH + x] = (uint8_t)((row[sx] + row[sx + 1] + next_row[sx] + next_row[sx + 1] + 2) >> 2);
+                }
+            }
+            return 0;
+        }
+
+        this->sws_ctx = sws_getCachedContext(this->sws_ctx, frame->width, frame->height, (AVPixelFormat)frame->format,
+                                             SCENE_THUMB_WIDTH, SCENE_THUMB_HEIGHT, AV_PIX_FMT_GRAY8,
+                                             SWS_AREA, nullptr, nullptr, nullptr);
+        if (this->sws_ctx == nullptr) {
+            std::cerr << "Can't get sws context for scene detection." << std::endl;
+            return GET_SWS_CTX_ERROR;
+        }
+
+        uint8_t *dst[4] = {thumb};
+        int dst_linesize[4] = {SCENE_THUMB_WIDTH};
+        sws_scale(this->sws_ctx, frame->data, frame->linesize, 0, frame->height, dst, dst_linesize);
+        return 0;
+    }
+
+public:
+    SCENE_DETECTOR() {
+        this->sws_ctx   = nullptr;
+        this->current   = 0;
+        this->frames    = 0;
+        this->thumbs[0].resize(SCENE_THUMB_WIDTH * SCENE_THUMB_HEIGHT);
+        this->thumbs[1].resize(SCENE_THUMB_WIDTH * SCENE_THUMB_HEIGHT);
+    }
+
+    ~SCENE_DETECTOR() {
+        sws_freeContext(this->sws_ctx);
+    }
+
+    /**
+     * Compare frame with previous frame.
+     * @param frame decoded frame.
+     * @param score output score, first frame is always a cut.
+     * @return 0 on success or negative error code on failure.
+     */
+    int analyze(const AVFrame *frame, SCENE_SCORE *score) {
+        int previous = this->current ^ 1;
+        uint8_t *thumb = this->thumbs[this->current].data();
+        uint32_t *histogram = this->histograms[this->current];
+        const int pixels = SCENE_THUMB_WIDTH * SCENE_THUMB_HEIGHT;
+
+        int ret = make_thumb(frame, thumb);
+        if (ret < 0) return ret;
+
+        memset(histogram, 0, sizeof(this->histograms[0]));
+        for (int i = 0; i < pixels; ++i) histogram[thumb[i] * SCENE_HISTOGRAM_BINS / 256]++;
+
+        if (this->frames++ == 0) {
+            *score = {1.0, 255.0, true};
+        }
+        else {
+            uint64_t histogram_diff = 0;
+            for (int i = 0; i < SCENE_HISTOGRAM_BINS; ++i) {
+                histogram_diff += (uint64_t)std::abs((int64_t)histogram[i] - (int64_t)this->histograms[previous][i]);
+            }
+
+            score->histogram_distance   = (double)histogram_diff / (2.0 * pixels);
+            score->mean_abs_diff        = (double)sum_abs_diff(thumb, this->thumbs[previous].data(), pixels) / pixels;
+            score->is_cut               = score->histogram_distance > SCENE_HISTOGRAM_THRESHOLD
+                                          && score->mean_abs_diff > SCENE_SAD_THRESHOLD;
+        }
+
+        this->current = previous;
+        return 0;
+    }
+};
+
+#endif //TUTORIAL_01_SCENE_DETECTOR_H
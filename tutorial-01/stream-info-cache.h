@@ -0,0 +1,385 @@
+#ifndef TUTORIAL_01_STREAM_INFO_CACHE_H
+#define TUTORIAL_01_STREAM_INFO_CACHE_H
+
+#include "iostream"
+#include "string"
+#include "vector"
+#include "map"
+#include "cstdio"
+#include "cstring"
+#include "algorithm"
+#include "sys/stat.h"
+#include "SDL.h"
+#include "error-code.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavutil/mem.h"
+}
+
+// Extension appended to input path for the stream info sidecar
+const char STREAM_INFO_EXTENSION[] = ".sinfo";
+
+// Bumped whenever layout of sidecar change, older sidecars are probed again
+const uint32_t STREAM_INFO_VERSION = 1;
+
+// Packets read at most to discover streams of a container without header (FLV, MPEG-TS) on a cache hit
+const int STREAM_INFO_MAX_DISCOVERY_PACKETS = 256;
+
+/**
+ * Limits of avformat_find_stream_info, 0 keep libavformat default (5 MB and 5 s).
+ */
+struct PROBE_SETTINGS {
+    int64_t probesize;          // Max bytes read while probing
+    int64_t analyze_duration;   // Max duration of data analyzed, in microseconds
+};
+
+/**
+ * Apply probe limits, must be called before avformat_open_input.
+ * @param format_ctx format context from avformat_alloc_context.
+ * @param settings probe limits.
+ */
+inline void apply_probe_settings(AVFormatContext *format_ctx, const PROBE_SETTINGS &settings) {
+    if (settings.probesize > 0) format_ctx->probesize = std::max((int64_t)32, settings.probesize);
+    if (settings.analyze_duration > 0) format_ctx->max_analyze_duration = settings.analyze_duration;
+}
+
+/**
+ * Stream layout and codec parameters found by probing, kept per file so reopening a known file skip probing.
+ *
+ * @note Entries are keyed on path and identified by size and modification time, a changed file is probed again.
+ *       Entries live in memory for the process (GOP workers and extra passes reopen the same file) and in a sidecar
+ *       "<input>.sinfo" for later runs. On a hit only the container header is read: streams declared by the header get
+ *       their cached parameters, streams of containers without header are discovered by reading a few packets, then
+ *       input is rewound. Anything not matching the cache (stream count, codec) fall back to probing.
+ */
+struct STREAM_INFO_CACHE {
+private:
+    struct ENTRY {
+        int64_t file_size;
+        int64_t file_mtime;
+        std::vector<uint8_t> blob;
+    };
+
+    /**
+     * Serialize fixed-size values into a blob.
+     */
+    struct BLOB_WRITER {
+        std::vector<uint8_t> data;
+
+        template<typename T> void put(const T &value) {
+            auto *bytes = (const uint8_t*)&value;
+            this->data.insert(this->data.end(), bytes, bytes + sizeof(T));
+        }
+
+        void put_bytes(const uint8_t *bytes, int size) {
+            put(size);
+            if (size > 0) this->data.insert(this->data.end(), bytes, bytes + size);
+        }
+    };
+
+    /**
+     * Read back values written by BLOB_WRITER, every read fail once blob is exhausted.
+     */
+    struct BLOB_READER {
+        const uint8_t *data;
+        size_t size;
+        size_t offset;
+
+        template<typename T> bool get(T *value) {
+            if (this->offset + sizeof(T) > this->size) return false;
+            memcpy(value, this->data + this->offset, sizeof(T));
+            this->offset += sizeof(T);
+            return true;
+        }
+
+        bool get_bytes(const uint8_t **bytes, int *size) {
+            if (!get(size) || *size < 0 || this->offset + *size > this->size) return false;
+            *bytes = this->data + this->offset;
+            this->offset += *size;
+            return true;
+        }
+    };
+
+    struct STREAM_TIMING {
+        int64_t start_time;
+        int64_t duration;
+        int64_t nb_frames;
+        AVRational avg_frame_rate;
+        AVRational r_frame_rate;
+    };
+
+    bool enabled;
+    std::map<std::string, ENTRY> entries;
+    SDL_mutex *mutex;
+
+    static bool serialize(const AVFormatContext *format_ctx, std::vector<uint8_t> *blob) {
+        BLOB_WRITER writer;
+
+        writer.put(STREAM_INFO_VERSION);
+        writer.put(format_ctx->nb_streams);
+        writer.put(format_ctx->start_time);
+        writer.put(format_ctx->duration);
+        writer.put(format_ctx->bit_rate);
+
+        for (unsigned int i = 0; i < format_ctx->nb_streams; ++i) {
+            const AVStream *stream = format_ctx->streams[i];
+            const AVCodecParameters *params = stream->codecpar;
+
+            // Custom channel maps point to memory owned by the stream, such files are always probed
+            if (params->ch_layout.order == AV_CHANNEL_ORDER_CUSTOM) return false;
+
+            writer.put(stream->start_time);
+            writer.put(stream->duration);
+            writer.put(stream->nb_frames);
+            writer.put(stream->avg_frame_rate);
+            writer.put(stream->r_frame_rate);
+
+            writer.put(params->codec_type);
+            writer.put(params->codec_id);
+            writer.put(params->codec_tag);
+            writer.put(params->format);
+            writer.put(params->bit_rate);
+            writer.put(params->bits_per_coded_sample);
+            writer.put(params->bits_per_raw_sample);
+            writer.put(params->profile);
+            writer.put(params->level);
+            writer.put(params->width);
+            writer.put(params->height);
+            writer.put(params->sample_aspect_ratio);
+            writer.put(params->field_order);
+            writer.put(params->color_range);
+            writer.put(params->color_primaries);
+            writer.put(params->color_trc);
+            writer.put(params->color_space);
+            writer.put(params->chroma_location);
+            writer.put(params->video_delay);
+            writer.put(params->ch_layout.order);
+            writer.put(params->ch_layout.nb_channels);
+            writer.put(params->ch_layout.u.mask);
+            writer.put(params->sample_rate);
+            writer.put(params->block_align);
+            writer.put(params->frame_size);
+            writer.put(params->initial_padding);
+            writer.put(params->trailing_padding);
+            writer.put(params->seek_preroll);
+            writer.put_bytes(params->extradata, params->extradata_size);
+        }
+
+        blob->swap(writer.data);
+        return true;
+    }
+
+    /**
+     * Make streams of containers without header appear by reading packets, then rewind input to where it was.
+     */
+    static bool discover_streams(AVFormatContext *format_ctx, unsigned int stream_count) {
+        if (format_ctx->nb_streams >= stream_count) return true;
+        if (!(format_ctx->ctx_flags & AVFMTCTX_NOHEADER) || format_ctx->pb == nullptr
+            || !(format_ctx->pb->seekable & AVIO_SEEKABLE_NORMAL)) return false;
+
+        int64_t data_start = avio_tell(format_ctx->pb);
+        AVPacket *packet = av_packet_alloc();
+        if (packet == nullptr) return false;
+
+        for (int i = 0; i < STREAM_INFO_MAX_DISCOVERY_PACKETS && format_ctx->nb_streams < stream_count; ++i) {
+            if (av_read_frame(format_ctx, packet) < 0) break;
+            av_packet_unref(packet);
+        }
+        av_packet_free(&packet);
+
+        if (avio_seek(format_ctx->pb, data_start, SEEK_SET) < 0) return false;
+        avformat_flush(format_ctx);
+        return format_ctx->nb_streams == stream_count;
+    }
+
+    static bool apply(AVFormatContext *format_ctx, const std::vector<uint8_t> &blob) {
+        BLOB_READER reader = {blob.data(), blob.size(), 0};
+        uint32_t version = 0;
+        unsigned int stream_count = 0;
+        int64_t start_time = 0, duration = 0, bit_rate = 0;
+
+        if (!reader.get(&version) || version != STREAM_INFO_VERSION || !reader.get(&stream_count)) return false;
+        if (!reader.get(&start_time) || !reader.get(&duration) || !reader.get(&bit_rate)) return false;
+        if (!discover_streams(format_ctx, stream_count) || format_ctx->nb_streams != stream_count) return false;
+
+        std::vector<AVCodecParameters*> cached(stream_count, nullptr);
+        std::vector<STREAM_TIMING> timing(stream_count);
+        bool valid = true;
+
+        // Whole blob is checked against the opened streams before any of them is touched
+        for (unsigned int i = 0; i < stream_count && valid; ++i) {
+            STREAM_TIMING *stream = &timing[i];
+            AVCodecParameters *params = cached[i] = avcodec_parameters_alloc();
+            const uint8_t *extradata = nullptr;
+
+            valid = params != nullptr
+                    && reader.get(&stream->start_time) && reader.get(&stream->duration) && reader.get(&stream->nb_frames)
+                    && reader.get(&stream->avg_frame_rate) && reader.get(&stream->r_frame_rate)
+                    && reader.get(&params->codec_type) && reader.get(&params->codec_id) && reader.get(&params->codec_tag)
+                    && reader.get(&params->format) && reader.get(&params->bit_rate)
+                    && reader.get(&params->bits_per_coded_sample) && reader.get(&params->bits_per_raw_sample)
+                    && reader.get(&params->profile) && reader.get(&params->level)
+                    && reader.get(&params->width) && reader.get(&params->height)
+                    && reader.get(&params->sample_aspect_ratio) && reader.get(&params->field_order)
+                    && reader.get(&params->color_range) && reader.get(&params->color_primaries)
+                    && reader.get(&params->color_trc) && reader.get(&params->color_space)
+                    && reader.get(&params->chroma_location) && reader.get(&params->video_delay)
+                    && reader.get(&params->ch_layout.order) && reader.get(&params->ch_layout.nb_channels)
+                    && reader.get(&params->ch_layout.u.mask) && reader.get(&params->sample_rate)
+                    && reader.get(&params->block_align) && reader.get(&params->frame_size)
+                    && reader.get(&params->initial_padding) && reader.get(&params->trailing_padding)
+                    && reader.get(&params->seek_preroll) && reader.get_bytes(&extradata, &params->extradata_size);
+            if (!valid) break;
+
+            const AVCodecParameters *opened = format_ctx->streams[i]->codecpar;
+            valid = opened->codec_type == params->codec_type
+                    && (opened->codec_id == AV_CODEC_ID_NONE || opened->codec_id == params->codec_id);
+
+            if (valid && params->extradata_size > 0) {
+                params->extradata = (uint8_t*)av_mallocz(params->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+                if ((valid = params->extradata != nullptr)) memcpy(params->extradata, extradata, params->extradata_size);
+            }
+            else {
+                params->extradata_size = 0;
+            }
+        }
+
+        for (unsigned int i = 0; i < stream_count && valid; ++i) {
+            AVStream *stream = format_ctx->streams[i];
+
+            valid = avcodec_parameters_copy(stream->codecpar, cached[i]) >= 0;
+            if (stream->start_time == AV_NOPTS_VALUE) stream->start_time = timing[i].start_time;
+            if (stream->duration == AV_NOPTS_VALUE) stream->duration = timing[i].duration;
+            if (stream->nb_frames == 0) stream->nb_frames = timing[i].nb_frames;
+            stream->avg_frame_rate  = timing[i].avg_frame_rate;
+            stream->r_frame_rate    = timing[i].r_frame_rate;
+        }
+
+        if (valid) {
+            if (format_ctx->start_time == AV_NOPTS_VALUE) format_ctx->start_time = start_time;
+            if (format_ctx->duration == AV_NOPTS_VALUE) format_ctx->duration = duration;
+            if (format_ctx->bit_rate == 0) format_ctx->bit_rate = bit_rate;
+        }
+
+        for (auto &params : cached) avcodec_parameters_free(&params);
+        return valid;
+    }
+
+    static bool load(const std::string &sidecar_path, const struct stat &info, ENTRY *entry) {
+        FILE *file = fopen(sidecar_path.data(), "rb");
+        if (file == nullptr) return false;
+
+        bool valid = fread(&entry->file_size, sizeof(entry->file_size), 1, file) == 1
+                     && fread(&entry->file_mtime, sizeof(entry->file_mtime), 1, file) == 1
+                     && entry->file_size == (int64_t)info.st_size && entry->file_mtime == (int64_t)info.st_mtime;
+
+        uint8_t chunk[4096];
+        size_t read_size;
+        while (valid && (read_size = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            entry->blob.insert(entry->blob.end(), chunk, chunk + read_size);
+        }
+        fclose(file);
+
+        return valid && !entry->blob.empty();
+    }
+
+    static void save(const std::string &sidecar_path, const ENTRY &entry) {
+        FILE *file = fopen(sidecar_path.data(), "wb");
+        if (file == nullptr) return;
+
+        bool written = fwrite(&entry.file_size, sizeof(entry.file_size), 1, file) == 1
+                       && fwrite(&entry.file_mtime, sizeof(entry.file_mtime), 1, file) == 1
+                       && fwrite(entry.blob.data(), 1, entry.blob.size(), file) == entry.blob.size();
+        if (fclose(file) != 0 || !written) remove(sidecar_path.data());
+    }
+
+    /**
+     * Find entry of file in memory or in its sidecar, must be called with the lock held.
+     */
+    bool lookup(const std::string &path, const struct stat &info, ENTRY *entry) {
+        auto found = this->entries.find(path);
+        if (found != this->entries.end() && found->second.file_size == (int64_t)info.st_size
+            && found->second.file_mtime == (int64_t)info.st_mtime) {
+            *entry = found->second;
+            return true;
+        }
+
+        if (!load(path + STREAM_INFO_EXTENSION, info, entry)) return false;
+        this->entries[path] = *entry;
+        return true;
+    }
+
+public:
+    STREAM_INFO_CACHE() {
+        this->enabled   = false;
+        this->mutex     = SDL_CreateMutex();
+    }
+
+    ~STREAM_INFO_CACHE() {
+        SDL_DestroyMutex(this->mutex);
+    }
+
+    STREAM_INFO_CACHE(const STREAM_INFO_CACHE&) = delete;
+    STREAM_INFO_CACHE &operator=(const STREAM_INFO_CACHE&) = delete;
+
+    /**
+     * Turn cache on, when off "find_stream_info" always probe.
+     */
+    void enable() {
+        this->enabled = true;
+    }
+
+    /**
+     * Turn cache off, for input not read from the path given to "find_stream_info" (shared memory).
+     */
+    void disable() {
+        this->enabled = false;
+    }
+
+    /**
+     * Fill stream info of opened input from cache, or probe it and store result for next opening.
+     * @param format_ctx format context opened with avformat_open_input.
+     * @param path path given to avformat_open_input, only local files are cached.
+     * @param from_cache output true when probing was skipped, can be nullptr.
+     * @return 0 on success or negative error code on failure.
+     */
+    int find_stream_info(AVFormatContext *format_ctx, const std::string &path, bool *from_cache) {
+        struct stat info = {};
+        bool cacheable = this->enabled && stat(path.data(), &info) == 0 && S_ISREG(info.st_mode);
+        ENTRY entry = {};
+
+        if (from_cache) *from_cache = false;
+
+        if (cacheable) {
+            SDL_LockMutex(this->mutex);
+            bool found = lookup(path, info, &entry);
+            SDL_UnlockMutex(this->mutex);
+
+            if (found && apply(format_ctx, entry.blob)) {
+                if (from_cache) *from_cache = true;
+                return 0;
+            }
+        }
+
+        if (avformat_find_stream_info(format_ctx, nullptr) < 0) {
+            std::cerr << "Can't find stream info." << std::endl;
+            return FIND_STREAM_INFO_ERROR;
+        }
+
+        if (cacheable && serialize(format_ctx, &entry.blob)) {
+            entry.file_size     = (int64_t)info.st_size;
+            entry.file_mtime    = (int64_t)info.st_mtime;
+
+            SDL_LockMutex(this->mutex);
+            this->entries[path] = entry;
+            save(path + STREAM_INFO_EXTENSION, entry);
+            SDL_UnlockMutex(this->mutex);
+        }
+
+        return 0;
+    }
+};
+
+#endif //TUTORIAL_01_STREAM_INFO_CACHE_H
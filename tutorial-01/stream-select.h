@@ -0,0 +1,67 @@
+#ifndef TUTORIAL_01_STREAM_SELECT_H
+#define TUTORIAL_01_STREAM_SELECT_H
+
+#include "iostream"
+#include "algorithm"
+#include "error-code.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+}
+
+/**
+ * Streams wanted from input.
+ */
+enum STREAM_SELECT {
+    STREAM_SELECT_BOTH,         // Video and audio, input with only one of them is played without the other
+    STREAM_SELECT_VIDEO_ONLY,
+    STREAM_SELECT_AUDIO_ONLY
+};
+
+/**
+ * Pick best video and audio stream of input and make demuxer discard every other stream.
+ *
+ * @note Discarded streams never come out of av_read_frame, so their packets are not queued or decoded and formats
+ *       with an index skip reading them at all. Audio stream is the one related to picked video stream when input has
+ *       several programs.
+ *
+ * @param format_ctx opened input with stream info.
+ * @param select streams wanted.
+ * @param video_stream_index output index of video stream, -1 when not used.
+ * @param audio_stream_index output index of audio stream, -1 when not used.
+ * @return 0 on success or negative error code when input has none of wanted streams.
+ */
+inline int select_streams(AVFormatContext *format_ctx, STREAM_SELECT select, int *video_stream_index,
+                          int *audio_stream_index) {
+    *video_stream_index = -1;
+    *audio_stream_index = -1;
+
+    if (select != STREAM_SELECT_AUDIO_ONLY) {
+        *video_stream_index = std::max(-1, av_find_best_stream(format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0));
+    }
+    if (select != STREAM_SELECT_VIDEO_ONLY) {
+        *audio_stream_index = std::max(-1, av_find_best_stream(format_ctx, AVMEDIA_TYPE_AUDIO, -1, *video_stream_index,
+                                                               nullptr, 0));
+    }
+
+    if (*video_stream_index < 0 && select != STREAM_SELECT_AUDIO_ONLY
+        && (select == STREAM_SELECT_VIDEO_ONLY || *audio_stream_index < 0)) {
+        std::cerr << "Can't find video stream." << std::endl;
+        return VIDEO_STREAM_NOT_FOUND;
+    }
+
+    if (*audio_stream_index < 0 && select == STREAM_SELECT_AUDIO_ONLY) {
+        std::cerr << "Can't find audio stream." << std::endl;
+        return AUDIO_STREAM_NOT_FOUND;
+    }
+
+    for (unsigned int i = 0; i < format_ctx->nb_streams; ++i) {
+        if ((int)i != *video_stream_index && (int)i != *audio_stream_index) {
+            format_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    return 0;
+}
+
+#endif //TUTORIAL_01_STREAM_SELECT_H
@@ -0,0 +1,642 @@
+#ifndef TUTORIAL_01_URING_INPUT_H
+#define TUTORIAL_01_URING_INPUT_H
+
+#include "iostream"
+#include "string"
+#include "vector"
+#include "deque"
+#include "algorithm"
+#include "cstring"
+#include "cerrno"
+#include "SDL.h"
+#include "SDL_thread.h"
+#include "error-code.h"
+#include "fcntl.h"
+#include "sys/stat.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "windows.h"
+#include "io.h"
+#else
+#include "unistd.h"
+#include "sys/uio.h"
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include("linux/io_uring.h")
+#include "linux/io_uring.h"
+#include "sys/syscall.h"
+#include "sys/mman.h"
+#include "sys/eventfd.h"
+#define IO_SERVICE_HAS_URING
+#endif
+#endif
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavformat/avio.h"
+#include "libavutil/mem.h"
+}
+
+// Max number of reads submitted to kernel at once, shared by every input of the service
+const unsigned IO_SERVICE_QUEUE_DEPTH = 64;
+
+// Size of one read issued by an input
+const int URING_INPUT_BLOCK_SIZE = 256 * 1024;
+
+// Reads each input keep in flight ahead of the demuxer
+const int URING_INPUT_READS_IN_FLIGHT = 4;
+
+/**
+ * One positioned read, owned by the input which submitted it.
+ */
+struct IO_REQUEST {
+    int fd;
+    uint8_t *buffer;
+    size_t size;
+    int64_t offset;
+#ifdef IO_SERVICE_HAS_URING
+    struct iovec iov;
+#endif
+    int result;                 // Bytes read or -errno, valid once "done"
+    bool done;
+};
+
+/**
+ * Open a regular file for positioned reads.
+ * @param path path of file.
+ * @param size output size of file.
+ * @return file descriptor, -1 when path is not a regular file.
+ */
+inline int open_read_file(const std::string &path, int64_t *size) {
+#ifdef _WIN32
+    int fd = _open(path.data(), _O_RDONLY | _O_BINARY);
+    struct _stat64 info = {};
+    if (fd >= 0 && (_fstat64(fd, &info) < 0 || !(info.st_mode & _S_IFREG))) {
+        _close(fd);
+        fd = -1;
+    }
+#else
+    int fd = open(path.data(), O_RDONLY | O_CLOEXEC);
+    struct stat info = {};
+    if (fd >= 0 && (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode))) {
+        close(fd);
+        fd = -1;
+    }
+#endif
+    *size = fd >= 0 ? (int64_t)info.st_size : 0;
+    return fd;
+}
+
+inline void close_read_file(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+/**
+ * Read at offset without moving file position, so many threads can share the file descriptor.
+ * @return bytes read, 0 at end of file or -errno on failure.
+ */
+inline int positioned_read(int fd, uint8_t *buffer, size_t size, int64_t offset) {
+#ifdef _WIN32
+    OVERLAPPED overlapped = {};
+    overlapped.Offset       = (DWORD)offset;
+    overlapped.OffsetHigh   = (DWORD)(offset >> 32);
+
+    DWORD read = 0;
+    if (!ReadFile((HANDLE)_get_osfhandle(fd), buffer, (DWORD)size, &read, &overlapped)) {
+        return GetLastError() == ERROR_HANDLE_EOF ? 0 : -EIO;
+    }
+    return (int)read;
+#else
+    ssize_t read = pread(fd, buffer, size, (off_t)offset);
+    return read < 0 ? -errno : (int)read;
+#endif
+}
+
+/**
+ * One I/O thread serving positioned reads of many inputs.
+ *
+ * @note On Linux reads are submitted to an io_uring so many of them are in flight at once, an eventfd read stay
+ *       armed in the ring so new requests wake the thread while it wait for completions. When io_uring is not
+ *       available (old kernel, disabled by policy, other systems) the thread serve requests one by one with pread
+ *       (ReadFile at an offset on Windows).
+ */
+struct IO_SERVICE {
+private:
+    std::deque<IO_REQUEST*> pending;
+    SDL_Thread *thread;
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    bool aborted;
+    bool uring;                 // Cleared by I/O thread when it fall back to pread, guarded by "mutex"
+    long submitted;
+
+#ifdef IO_SERVICE_HAS_URING
+    int ring_fd;
+    int event_fd;
+    uint64_t event_value;
+    struct iovec event_iov;
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned sq_entries;
+
+    bool setup_uring() {
+        struct io_uring_params params = {};
+        this->ring_fd = (int)syscall(__NR_io_uring_setup, IO_SERVICE_QUEUE_DEPTH, &params);
+        if (this->ring_fd < 0) return false;
+
+        this->sq_entries    = params.sq_entries;
+        this->sq_size       = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        this->cq_size       = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) this->sq_size = this->cq_size = std::max(this->sq_size, this->cq_size);
+
+        this->sq_ptr = mmap(nullptr, this->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd, IORING_OFF_SQ_RING);
+        if (this->sq_ptr == MAP_FAILED) {
+            this->sq_ptr = nullptr;
+            return false;
+        }
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            this->cq_ptr = this->sq_ptr;
+        }
+        else {
+            this->cq_ptr = mmap(nullptr, this->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd, IORING_OFF_CQ_RING);
+            if (this->cq_ptr == MAP_FAILED) {
+                this->cq_ptr = nullptr;
+                return false;
+            }
+        }
+
+        this->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        this->sqes = (struct io_uring_sqe*)mmap(nullptr, this->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                                this->ring_fd, IORING_OFF_SQES);
+        if (this->sqes == MAP_FAILED) {
+            this->sqes = nullptr;
+            return false;
+        }
+
+        auto *sq = (uint8_t*)this->sq_ptr;
+        auto *cq = (uint8_t*)this->cq_ptr;
+        this->sq_tail   = (unsigned*)(sq + params.sq_off.tail);
+        this->sq_mask   = (unsigned*)(sq + params.sq_off.ring_mask);
+        this->sq_array  = (unsigned*)(sq + params.sq_off.array);
+        this->cq_head   = (unsigned*)(cq + params.cq_off.head);
+        this->cq_tail   = (unsigned*)(cq + params.cq_off.tail);
+        this->cq_mask   = (unsigned*)(cq + params.cq_off.ring_mask);
+        this->cqes      = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+        this->event_fd = eventfd(0, EFD_CLOEXEC);
+        return this->event_fd >= 0;
+    }
+
+    void teardown_uring() {
+        if (this->sqes) munmap(this->sqes, this->sqes_size);
+        if (this->cq_ptr && this->cq_ptr != this->sq_ptr) munmap(this->cq_ptr, this->cq_size);
+        if (this->sq_ptr) munmap(this->sq_ptr, this->sq_size);
+        if (this->ring_fd >= 0) close(this->ring_fd);
+        if (this->event_fd >= 0) close(this->event_fd);
+        this->sqes      = nullptr;
+        this->cq_ptr    = nullptr;
+        this->sq_ptr    = nullptr;
+        this->ring_fd   = -1;
+        this->event_fd  = -1;
+    }
+
+    /**
+     * Queue a readv into submission ring, only called by I/O thread.
+     */
+    void push_read(int fd, struct iovec *iov, int64_t offset, uint64_t user_data) {
+        unsigned tail = *this->sq_tail;
+        unsigned index = tail & *this->sq_mask;
+        struct io_uring_sqe *sqe = &this->sqes[index];
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode     = IORING_OP_READV;
+        sqe->fd         = fd;
+        sqe->addr       = (uint64_t)(uintptr_t)iov;
+        sqe->len        = 1;
+        sqe->off        = (uint64_t)offset;
+        sqe->user_data  = user_data;
+
+        this->sq_array[index] = index;
+        __atomic_store_n(this->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    static int uring_thread(void *userdata) {
+        auto *service = (IO_SERVICE*)userdata;
+        std::vector<IO_REQUEST*> in_flight;
+        unsigned to_submit = 0;
+        bool event_armed = false;
+
+        for (;;) {
+            // eventfd read is armed again after each wake up, so one slot of the ring is kept for it
+            if (!event_armed) {
+                service->push_read(service->event_fd, &service->event_iov, 0, 0);
+                event_armed = true;
+                to_submit++;
+            }
+
+            SDL_LockMutex(service->mutex);
+            if (service->aborted && in_flight.empty()) {
+                SDL_UnlockMutex(service->mutex);
+                break;
+            }
+
+            while (!service->pending.empty() && in_flight.size() + 1 < service->sq_entries) {
+                IO_REQUEST *request = service->pending.front();
+                service->pending.pop_front();
+
+                request->iov = {request->buffer, request->size};
+                service->push_read(request->fd, &request->iov, request->offset, (uint64_t)(uintptr_t)request);
+                in_flight.push_back(request);
+                to_submit++;
+            }
+            SDL_UnlockMutex(service->mutex);
+
+            int ret = (int)syscall(__NR_io_uring_enter, service->ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0 && errno != EINTR) {
+                // Ring is unusable: reads in flight fail, queued and later reads are served by pread
+                int error = errno;
+                std::cerr << "io_uring_enter failed, reading with pread: " << strerror(error) << std::endl;
+
+                for (auto request : in_flight) service->complete(request, -error);
+
+                SDL_LockMutex(service->mutex);
+                service->uring = false;
+                SDL_UnlockMutex(service->mutex);
+                return pread_thread(userdata);
+            }
+            if (ret > 0) to_submit -= std::min((unsigned)ret, to_submit);
+
+            unsigned head = *service->cq_head;
+            unsigned tail = __atomic_load_n(service->cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                struct io_uring_cqe *cqe = &service->cqes[head & *service->cq_mask];
+
+                if (cqe->user_data == 0) {
+                    event_armed = false;
+                    continue;
+                }
+
+                auto *request = (IO_REQUEST*)(uintptr_t)cqe->user_data;
+                int result = cqe->res;
+
+                // Kernel without async read support for this file, serve it here
+                if (result == -EINVAL || result == -EOPNOTSUPP) {
+                    result = positioned_read(request->fd, request->buffer, request->size, request->offset);
+                }
+
+                service->complete(request, result);
+                in_flight.erase(std::find(in_flight.begin(), in_flight.end(), request));
+            }
+            __atomic_store_n(service->cq_head, head, __ATOMIC_RELEASE);
+        }
+
+        return 0;
+    }
+#endif
+
+    void complete(IO_REQUEST *request, int result) {
+        SDL_LockMutex(this->mutex);
+        request->result = result;
+        request->done = true;
+        SDL_CondBroadcast(this->cond);
+        SDL_UnlockMutex(this->mutex);
+    }
+
+    static int pread_thread(void *userdata) {
+        auto *service = (IO_SERVICE*)userdata;
+
+        SDL_LockMutex(service->mutex);
+        for (;;) {
+            while (service->pending.empty() && !service->aborted) SDL_CondWait(service->cond, service->mutex);
+            if (service->pending.empty()) break;
+
+            IO_REQUEST *request = service->pending.front();
+            service->pending.pop_front();
+            SDL_UnlockMutex(service->mutex);
+
+            service->complete(request, positioned_read(request->fd, request->buffer, request->size, request->offset));
+
+            SDL_LockMutex(service->mutex);
+        }
+        SDL_UnlockMutex(service->mutex);
+
+        return 0;
+    }
+
+public:
+    IO_SERVICE() {
+        this->thread    = nullptr;
+        this->mutex     = SDL_CreateMutex();
+        this->cond      = SDL_CreateCond();
+        this->aborted   = false;
+        this->uring     = false;
+        this->submitted = 0;
+#ifdef IO_SERVICE_HAS_URING
+        this->ring_fd       = -1;
+        this->event_fd      = -1;
+        this->event_value   = 0;
+        this->event_iov     = {&this->event_value, sizeof(this->event_value)};
+        this->sq_ptr        = nullptr;
+        this->cq_ptr        = nullptr;
+        this->sqes          = nullptr;
+#endif
+    }
+
+    /**
+     * Every input using the service must be destroyed first.
+     */
+    ~IO_SERVICE() {
+        SDL_LockMutex(this->mutex);
+        this->aborted = true;
+        bool wake = this->uring;
+        SDL_CondBroadcast(this->cond);
+        SDL_UnlockMutex(this->mutex);
+
+#ifdef IO_SERVICE_HAS_URING
+        if (wake) {
+            uint64_t value = 1;
+            if (write(this->event_fd, &value, sizeof(value)) < 0) std::cerr << "Can't wake I/O thread." << std::endl;
+        }
+#endif
+
+        if (this->thread) SDL_WaitThread(this->thread, nullptr);
+
+#ifdef IO_SERVICE_HAS_URING
+        teardown_uring();
+#endif
+        SDL_DestroyCond(this->cond);
+        SDL_DestroyMutex(this->mutex);
+    }
+
+    IO_SERVICE(const IO_SERVICE&) = delete;
+    IO_SERVICE &operator=(const IO_SERVICE&) = delete;
+
+    /**
+     * Start I/O thread.
+     * @param allow_uring false to always use pread.
+     * @return 0 on success or negative error code on failure.
+     */
+    int start(bool allow_uring) {
+#ifdef IO_SERVICE_HAS_URING
+        if (allow_uring) {
+            this->uring = setup_uring();
+            if (!this->uring) teardown_uring();
+        }
+        this->thread = SDL_CreateThread(this->uring ? uring_thread : pread_thread, "io-service", this);
+#else
+        this->thread = SDL_CreateThread(pread_thread, "io-service", this);
+#endif
+        if (this->thread == nullptr) {
+            std::cerr << "Can't create I/O thread with error: " << SDL_GetError() << std::endl;
+            return CREATE_IO_THREAD_ERROR;
+        }
+
+        return 0;
+    }
+
+    /**
+     * True when reads go through io_uring, false when served by pread (from start or after io_uring failed).
+     */
+    bool is_uring() const {
+        SDL_LockMutex(this->mutex);
+        bool uring = this->uring;
+        SDL_UnlockMutex(this->mutex);
+
+        return uring;
+    }
+
+    /**
+     * Queue a read, request must stay alive until "wait" return.
+     * @param request read to do.
+     */
+    void submit(IO_REQUEST *request) {
+        request->done = false;
+
+        SDL_LockMutex(this->mutex);
+        this->pending.push_back(request);
+        this->submitted++;
+        bool wake = this->uring;
+        SDL_CondBroadcast(this->cond);
+        SDL_UnlockMutex(this->mutex);
+
+#ifdef IO_SERVICE_HAS_URING
+        if (wake) {
+            uint64_t value = 1;
+            if (write(this->event_fd, &value, sizeof(value)) < 0) std::cerr << "Can't wake I/O thread." << std::endl;
+        }
+#endif
+    }
+
+    /**
+     * Block until read is done.
+     * @param request submitted read.
+     */
+    void wait(IO_REQUEST *request) {
+        SDL_LockMutex(this->mutex);
+        while (!request->done) SDL_CondWait(this->cond, this->mutex);
+        SDL_UnlockMutex(this->mutex);
+    }
+
+    /**
+     * Get number of reads submitted by every input.
+     */
+    long read_count() const {
+        return this->submitted;
+    }
+};
+
+/**
+ * Local file read through a shared IO_SERVICE, served to the demuxer through a custom AVIOContext.
+ *
+ * @note Each input keep "URING_INPUT_READS_IN_FLIGHT" consecutive blocks requested ahead of the demuxer, so with
+ *       io_uring the kernel always has work queued for every input. A seek wait for reads in flight, then request
+ *       blocks from the new position.
+ */
+struct URING_INPUT {
+private:
+    struct SLOT {
+        std::vector<uint8_t> data;
+        IO_REQUEST request;
+        bool issued;
+    };
+
+    IO_SERVICE *service;
+    int fd;
+    int64_t size;
+    AVIOContext *avio_ctx;
+    std::vector<SLOT> slots;
+    size_t head;                // Slot holding bytes at "base"
+    int64_t base;               // File offset of head slot
+    int head_offset;            // Bytes of head slot already given to demuxer
+
+    /**
+     * Request block at offset into slot, nothing is requested past end of file.
+     */
+    void issue(SLOT *slot, int64_t offset) {
+        slot->issued = offset < this->size;
+        if (!slot->issued) return;
+
+        slot->request.fd        = this->fd;
+        slot->request.buffer    = slot->data.data();
+        slot->request.size      = (size_t)std::min((int64_t)URING_INPUT_BLOCK_SIZE, this->size - offset);
+        slot->request.offset    = offset;
+        this->service->submit(&slot->request);
+    }
+
+    /**
+     * Wait every read in flight and request blocks from offset.
+     */
+    void restart(int64_t offset) {
+        for (auto &slot : this->slots) {
+            if (slot.issued) this->service->wait(&slot.request);
+        }
+
+        this->head          = 0;
+        this->base          = offset;
+        this->head_offset   = 0;
+        for (size_t i = 0; i < this->slots.size(); ++i) {
+            issue(&this->slots[i], offset + (int64_t)i * URING_INPUT_BLOCK_SIZE);
+        }
+    }
+
+    static int read_packet(void *opaque, uint8_t *buffer, int buffer_size) {
+        auto *input = (URING_INPUT*)opaque;
+        SLOT *slot = &input->slots[input->head];
+
+        if (!slot->issued) return AVERROR_EOF;
+
+        input->service->wait(&slot->request);
+        if (slot->request.result < 0) return slot->request.result;
+        if (slot->request.result == 0) return AVERROR_EOF;
+
+        int size = std::min(buffer_size, slot->request.result - input->head_offset);
+        memcpy(buffer, slot->data.data() + input->head_offset, size);
+        input->head_offset += size;
+
+        // Head block is consumed, reuse its slot for the block after the last one in flight
+        if (input->head_offset == slot->request.result) {
+            bool short_read = (size_t)slot->request.result < slot->request.size;
+
+            input->base += slot->request.result;
+            input->head_offset = 0;
+            input->head = (input->head + 1) % input->slots.size();
+
+            // Blocks after a short read were requested at wrong offsets
+            if (short_read) input->restart(input->base);
+            else input->issue(slot, input->base + (int64_t)(input->slots.size() - 1) * URING_INPUT_BLOCK_SIZE);
+        }
+
+        return size;
+    }
+
+    static int64_t seek(void *opaque, int64_t offset, int whence) {
+        auto *input = (URING_INPUT*)opaque;
+        int64_t position;
+
+        switch (whence & ~AVSEEK_FORCE) {
+            case AVSEEK_SIZE:   return input->size;
+            case SEEK_SET:      position = offset; break;
+            case SEEK_CUR:      position = input->base + input->head_offset + offset; break;
+            case SEEK_END:      position = input->size + offset; break;
+            default:            return AVERROR(EINVAL);
+        }
+
+        if (position < 0 || position > input->size) return AVERROR(EINVAL);
+
+        // Inside head block, nothing to read again
+        SLOT *slot = &input->slots[input->head];
+        if (slot->issued && position >= input->base && position < input->base + (int64_t)slot->request.size) {
+            input->service->wait(&slot->request);
+            if (slot->request.result > 0 && position < input->base + slot->request.result) {
+                input->head_offset = (int)(position - input->base);
+                return position;
+            }
+        }
+
+        input->restart(position);
+        return position;
+    }
+
+public:
+    explicit URING_INPUT(IO_SERVICE *service) {
+        this->service       = service;
+        this->fd            = -1;
+        this->size          = 0;
+        this->avio_ctx      = nullptr;
+        this->head          = 0;
+        this->base          = 0;
+        this->head_offset   = 0;
+    }
+
+    /**
+     * Must be destroyed after the format context using it is closed.
+     */
+    ~URING_INPUT() {
+        for (auto &slot : this->slots) {
+            if (slot.issued) this->service->wait(&slot.request);
+        }
+
+        if (this->avio_ctx) {
+            av_freep(&this->avio_ctx->buffer);
+            avio_context_free(&this->avio_ctx);
+        }
+        if (this->fd >= 0) close_read_file(this->fd);
+    }
+
+    URING_INPUT(const URING_INPUT&) = delete;
+    URING_INPUT &operator=(const URING_INPUT&) = delete;
+
+    /**
+     * Open file and make format context read it through the service.
+     * @param path path of local file.
+     * @param format_ctx format context not opened yet, from avformat_alloc_context.
+     * @return true when input is set up, false when file can't be opened as a regular file and format context is left
+     *         untouched.
+     */
+    bool attach(const std::string &path, AVFormatContext *format_ctx) {
+        this->fd = open_read_file(path, &this->size);
+        if (this->fd < 0) return false;
+
+        auto *buffer = (uint8_t*)av_malloc(URING_INPUT_BLOCK_SIZE);
+        if (buffer == nullptr) return false;
+
+        this->avio_ctx = avio_alloc_context(buffer, URING_INPUT_BLOCK_SIZE, 0, this, read_packet, nullptr, seek);
+        if (this->avio_ctx == nullptr) {
+            av_free(buffer);
+            return false;
+        }
+
+        this->slots.resize(URING_INPUT_READS_IN_FLIGHT);
+        for (auto &slot : this->slots) {
+            slot.data.resize(URING_INPUT_BLOCK_SIZE);
+            slot.issued = false;
+        }
+        restart(0);
+
+        format_ctx->pb = this->avio_ctx;
+        format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+        return true;
+    }
+};
+
+#endif //TUTORIAL_01_URING_INPUT_H
@@ -0,0 +1,134 @@
+#ifndef TUTORIAL_01_VIDEO_INPUT_H
+#define TUTORIAL_01_VIDEO_INPUT_H
+
+#include "iostream"
+#include "string"
+#include "error-code.h"
+#include "uring-input.h"
+#include "stream-info-cache.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+}
+
+/**
+ * An input file opened for its video stream only, every engine thread own one of these.
+ */
+struct VIDEO_INPUT {
+    AVFormatContext     *format_ctx;
+    int                 video_stream_index;
+    AVStream            *video_stream;
+    AVCodecContext      *video_codec_ctx;
+    URING_INPUT         *io_input;      // Reads through a shared IO_SERVICE, nullptr when file protocol is used
+};
+
+/**
+ * Free everything inside input, safe to call on partly opened input.
+ * @param input input to close.
+ */
+inline void close_video_input(VIDEO_INPUT *input) {
+    avcodec_free_context(&input->video_codec_ctx);
+    avformat_close_input(&input->format_ctx);
+    delete input->io_input;
+    input->io_input             = nullptr;
+    input->video_stream_index   = -1;
+    input->video_stream         = nullptr;
+}
+
+/**
+ * Open input file, find its video stream and optionally open a decoder for it. Other streams are discarded by the
+ * demuxer.
+ * @param path path of input file.
+ * @param open_decoder false when only packets are needed.
+ * @param thread_count number of decoder threads, 0 let libavcodec choose.
+ * @param input output input, must be closed with "close_video_input".
+ * @param io_service I/O thread shared by inputs, nullptr to read with file protocol.
+ * @param stream_info_cache cache of stream info shared by inputs, nullptr to always probe.
+ * @return 0 on success or negative error code on failure.
+ */
+inline int open_video_input(const std::string &path, bool open_decoder, int thread_count, VIDEO_INPUT *input,
+                            IO_SERVICE *io_service = nullptr, STREAM_INFO_CACHE *stream_info_cache = nullptr) {
+    input->format_ctx           = nullptr;
+    input->video_stream_index   = -1;
+    input->video_stream         = nullptr;
+    input->video_codec_ctx      = nullptr;
+    input->io_input             = nullptr;
+
+    if (io_service) {
+        if ((input->format_ctx = avformat_alloc_context()) == nullptr) {
+            std::cerr << "Can't alloc memory for AVFormatContext." << std::endl;
+            return ALLOC_FMT_CTX_ERROR;
+        }
+
+        // Files which are not regular (pipe, URL) fall back to file protocol
+        input->io_input = new URING_INPUT(io_service);
+        if (!input->io_input->attach(path, input->format_ctx)) {
+            delete input->io_input;
+            input->io_input = nullptr;
+        }
+    }
+
+    if ((avformat_open_input(&input->format_ctx, path.data(), nullptr, nullptr)) < 0) {
+        std::cerr << "Can't open input file with given path." << std::endl;
+        return OPEN_INPUT_ERROR;
+    }
+
+    if (stream_info_cache) {
+        int ret = stream_info_cache->find_stream_info(input->format_ctx, path, nullptr);
+        if (ret < 0) {
+            close_video_input(input);
+            return ret;
+        }
+    }
+    else if ((avformat_find_stream_info(input->format_ctx, nullptr)) < 0) {
+        std::cerr << "Can't find stream info." << std::endl;
+        close_video_input(input);
+        return FIND_STREAM_INFO_ERROR;
+    }
+
+    const AVCodec *video_codec = nullptr;
+    input->video_stream_index = av_find_best_stream(input->format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &video_codec, 0);
+    if (input->video_stream_index < 0) {
+        std::cerr << "Can't find video stream." << std::endl;
+        close_video_input(input);
+        return VIDEO_STREAM_NOT_FOUND;
+    }
+
+    input->video_stream = input->format_ctx->streams[input->video_stream_index];
+    for (unsigned int i = 0; i < input->format_ctx->nb_streams; ++i) {
+        if ((int)i != input->video_stream_index) input->format_ctx->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    if (!open_decoder) return 0;
+
+    if (video_codec == nullptr) {
+        std::cerr << "Can't find decoder for video with codec: " << avcodec_get_name(input->video_stream->codecpar->codec_id) << std::endl;
+        close_video_input(input);
+        return FIND_VIDEO_DECODER_ERROR;
+    }
+
+    if ((input->video_codec_ctx = avcodec_alloc_context3(video_codec)) == nullptr) {
+        std::cerr << "Can't alloc video codec context." << std::endl;
+        close_video_input(input);
+        return ALLOC_VIDEO_CODEC_CTX_ERROR;
+    }
+
+    if ((avcodec_parameters_to_context(input->video_codec_ctx, input->video_stream->codecpar)) < 0) {
+        std::cerr << "Can't copy video codec params to video codec context." << std::endl;
+        close_video_input(input);
+        return COPY_VIDEO_CODEC_PARAMS_ERROR;
+    }
+
+    input->video_codec_ctx->thread_count = thread_count;
+
+    if (avcodec_open2(input->video_codec_ctx, video_codec, nullptr) < 0) {
+        std::cerr << "Can't open video codec context." << std::endl;
+        close_video_input(input);
+        return OPEN_VIDEO_CODEC_ERROR;
+    }
+
+    return 0;
+}
+
+#endif //TUTORIAL_01_VIDEO_INPUT_H
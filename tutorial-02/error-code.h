@@ -26,7 +26,9 @@ enum ERROR_CODE {
     INIT_SDL_LIB_ERROR,
     CREATE_SDL_WINDOW_ERROR,
     CREATE_SDL_RENDERER_ERROR,
-    CREATE_SDL_TEXTURE_ERROR
+    CREATE_SDL_TEXTURE_ERROR,
+    CREATE_SCALER_THREAD_ERROR,
+    CREATE_RENDER_BACKEND_ERROR
 };
 
 #endif //TUTORIAL_02_ERROR_CODE_H
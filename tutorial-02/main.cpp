@@ -1,6 +1,15 @@
 #include "iostream"
 #include "SDL.h"
 #include "error-code.h"
+#include "sliced-scaler.h"
+#include "render-backend.h"
+#include "stage-timer.h"
+#include "mmap-input.h"
+#include "read-ahead-input.h"
+#include "memory-input.h"
+#include "pipe-input.h"
+#include "stream-info-cache.h"
+#include "stream-select.h"
 
 extern "C" {
 #include "libavformat/avformat.h"
@@ -11,160 +20,240 @@ extern "C" {
 
 using namespace std;
 
-SDL_Window      *window             = nullptr;
-SDL_Renderer    *renderer           = nullptr;
-SDL_Texture     *texture            = nullptr;
-SDL_Rect        display_rect;
-SDL_Event       event;
-
 /**
- * Init SDL library for render video frame on screen
- * @param SCREEN_WIDTH width of window want to create
- * @param SCREEN_HEIGHT height of window want to create
+ * Get size of display target, frame is fit into it with same aspect ratio and never scaled up.
+ * @param query_display use usable bounds of the first display when no max size is given.
+ * @param max_width max width from command line, 0 when not given.
+ * @param max_height max height from command line, 0 when not given.
+ * @param src_width width of decoded frame.
+ * @param src_height height of decoded frame.
+ * @param width output width of display target.
+ * @param height output height of display target.
  * @return 0 on success or negative error code on failure
  */
-int init_sdl(const int SCREEN_WIDTH, const int SCREEN_HEIGHT) {
-    if ((SDL_Init(SDL_INIT_VIDEO)) < 0) {
-        cerr << "Can't init SDL library with error: " << SDL_GetError() << endl;
-        return INIT_SDL_LIB_ERROR;
-    }
+int get_display_size(bool query_display, int max_width, int max_height, int src_width, int src_height, int *width, int *height) {
+    SDL_Rect bounds = {0, 0, src_width, src_height};
 
-    window = SDL_CreateWindow("FFmpeg tutorial", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
-    if (window == nullptr) {
-        cerr << "Can't create SDL window with error: " << SDL_GetError() << endl;
-        return CREATE_SDL_WINDOW_ERROR;
+    if (max_width > 0 && max_height > 0) {
+        bounds.w = max_width;
+        bounds.h = max_height;
     }
+    else if (query_display) {
+        if ((SDL_Init(SDL_INIT_VIDEO)) < 0) {
+            cerr << "Can't init SDL library with error: " << SDL_GetError() << endl;
+            return INIT_SDL_LIB_ERROR;
+        }
 
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
-    if (renderer == nullptr) {
-        cerr << "Can't create SDL renderer with error: " << SDL_GetError() << endl;
-        return CREATE_SDL_RENDERER_ERROR;
+        if (SDL_GetDisplayUsableBounds(0, &bounds) < 0) {
+            cerr << "Can't get display bounds, use frame size: " << SDL_GetError() << endl;
+            bounds.w = src_width;
+            bounds.h = src_height;
+        }
     }
 
-    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_IYUV, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
-    if (texture == nullptr) {
-        cerr << "Can't create SDL texture with error: " << SDL_GetError() << endl;
-        return CREATE_SDL_TEXTURE_ERROR;
-    }
+    double ratio = min(1.0, min((double)bounds.w / src_width, (double)bounds.h / src_height));
 
-    display_rect.x = 0;
-    display_rect.y = 0;
-    display_rect.w = SCREEN_WIDTH;
-    display_rect.h = SCREEN_HEIGHT;
+    // YUV420 need even width and height
+    *width  = max(2, (int)(src_width * ratio) & ~1);
+    *height = max(2, (int)(src_height * ratio) & ~1);
 
     return 0;
 }
 
+/**
+ * Choose biggest lowres factor of decoder which still produce frame not smaller than display target.
+ * @param codec video decoder.
+ * @param src_width width of coded frame.
+ * @param src_height height of coded frame.
+ * @param width width of display target.
+ * @param height height of display target.
+ * @return lowres factor, 0 when decoder does not support lowres decoding.
+ */
+int choose_lowres(const AVCodec *codec, int src_width, int src_height, int width, int height) {
+    int lowres = 0;
+
+    while (lowres < codec->max_lowres
+           && (src_width >> (lowres + 1)) >= width
+           && (src_height >> (lowres + 1)) >= height) {
+        lowres++;
+    }
+
+    return lowres;
+}
+
+/**
+ * Print time from launch to first presented frame.
+ * @param launched performance counter at start of main.
+ * @param stream_info_time performance counter ticks spent finding stream info.
+ * @param stream_info_cached true when stream info came from cache instead of probing.
+ */
+void print_time_to_first_frame(Uint64 launched, Uint64 stream_info_time, bool stream_info_cached) {
+    double frequency = (double)SDL_GetPerformanceFrequency();
+
+    cout << "Time to first frame: " << (double)(SDL_GetPerformanceCounter() - launched) / frequency * 1000.0
+         << " ms (stream info " << (stream_info_cached ? "from cache" : "probed") << " in "
+         << (double)stream_info_time / frequency * 1000.0 << " ms)." << endl;
+}
+
 int main(int argc, char *args[]) {
+    Uint64                  launched                    = STAGE_TIMER::now();
     int                     ret                         = 0;
     bool                    quit                        = false;
     AVFormatContext         *format_ctx                 = nullptr;
     string                  file_path                   = "../../videos/video.flv";
+    MMAP_INPUT              mmap_input;
+    READ_AHEAD_INPUT        read_ahead_input;
+    MEMORY_INPUT            memory_input;
+    PIPE_INPUT              pipe_input;
+    bool                    use_pipe                    = false;
+    Uint64                  opened                      = 0;
+    bool                    load_in_memory              = false;
+    string                  shm_name;
+    PROBE_SETTINGS          probe_settings              = {0, 0};
+    STREAM_INFO_CACHE       stream_info_cache;
+    bool                    stream_info_cached          = false;
+    Uint64                  stream_info_time            = 0;
+    int                     read_ahead_mb               = 0;
+    bool                    use_read_ahead              = false;
     int                     video_stream_index          = -1;
     int                     audio_stream_index          = -1;
     AVStream                *video_stream               = nullptr;
-    AVStream                *audio_stream               = nullptr;
     AVCodecParameters       *video_codec_params         = nullptr;
-    AVCodecParameters       *audio_codec_params         = nullptr;
     const AVCodec           *video_codec                = nullptr;
-    const AVCodec           *audio_codec                = nullptr;
     AVCodecContext          *video_codec_ctx            = nullptr;
-    AVCodecContext          *audio_codec_ctx            = nullptr;
     AVPacket                *packet                     = nullptr;
     AVFrame                 *frame                      = nullptr;
-    SwsContext              *sws_ctx                    = nullptr;
+    SLICED_SCALER           scaler;
+    const char              *backend_name               = "window";
+    RENDER_BACKEND          *backend                    = nullptr;
+    STAGE_TIMER             stage_timer;
+    long                    presented_frames            = 0;
+    int                     max_width                   = 0;
+    int                     max_height                  = 0;
+    int                     display_width               = 0;
+    int                     display_height              = 0;
     uint8_t                 *yuv420_frame[4]            = {nullptr};
     int                     yuv420_frame_linesize[4]    = {0};
 
+    /*
+     * Command line: [max_width max_height] [--backend=window|offscreen|null] [--read-ahead=MB] [--memory] [--shm=NAME]
+     * [--input=PATH]
+     * Offscreen and null backends need no display and run the pipeline as fast as possible. "--read-ahead" read input
+     * on an I/O thread with a window of MB instead of mapping it. "--memory" load whole input in memory before playing
+     * and "--shm" play media from shared-memory segment NAME, input path then only hint the container format.
+     * "--probesize=BYTES" and "--analyzeduration=US" limit probing of stream info, "--stream-info-cache" keep probed
+     * stream info in "<input>.sinfo" so next runs skip probing. Time to first frame is printed once it is presented.
+     * "--input" play PATH instead of sample video, "-" (or "pipe:") read standard input. Standard input and named pipes
+     * are read forward only with low-delay demuxing, startup and arrival to present latency are then reported.
+     */
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(args[i], "--backend=", 10) == 0) backend_name = args[i] + 10;
+        else if (strncmp(args[i], "--read-ahead=", 13) == 0) read_ahead_mb = atoi(args[i] + 13);
+        else if (strcmp(args[i], "--memory") == 0) load_in_memory = true;
+        else if (strncmp(args[i], "--shm=", 6) == 0) shm_name = args[i] + 6;
+        else if (strncmp(args[i], "--probesize=", 12) == 0) probe_settings.probesize = atoll(args[i] + 12);
+        else if (strncmp(args[i], "--analyzeduration=", 18) == 0) probe_settings.analyze_duration = atoll(args[i] + 18);
+        else if (strcmp(args[i], "--stream-info-cache") == 0) stream_info_cache.enable();
+        else if (strncmp(args[i], "--input=", 8) == 0) file_path = args[i] + 8;
+        else if (max_width == 0) max_width = atoi(args[i]);
+        else max_height = atoi(args[i]);
+    }
+
     // Alloc format context for store data inside input file
     if ((format_ctx = avformat_alloc_context()) == nullptr) {
         cerr << "Can't alloc memory for AVFormatContext." << endl;
         return ALLOC_FMT_CTX_ERROR;
     }
 
-    // Open input file and store data in format_ctx
-    if ((avformat_open_input(&format_ctx, file_path.data(), nullptr, nullptr)) < 0) {
-        cerr << "Can't open input file with given path." << endl;
-        return OPEN_INPUT_ERROR;
-    }
+    // "--shm" and "--memory" serve input from memory so nothing is read from disk while demuxing. Otherwise local files
+    // are served from a memory mapping, with "--read-ahead" or when input can't be mapped (URL) an I/O thread read ahead
+    // of the demuxer instead. Pipes can't be mapped nor seeked, they are read forward as data arrive
+    if (!shm_name.empty()) {
+        if (!memory_input.attach_shared_memory(shm_name, format_ctx)) {
+            cerr << "Can't map shared memory: " << shm_name << endl;
+            return OPEN_INPUT_ERROR;
+        }
 
-    // Find stream info in input file
-    if ((avformat_find_stream_info(format_ctx, nullptr)) < 0) {
-        cerr << "Can't find stream info." << endl;
-        return FIND_STREAM_INFO_ERROR;
+        // Input path only hint the format, cache entry of that path would describe other media
+        stream_info_cache.disable();
     }
-
-    // Find audio and video stream
-    for (int i = 0; i < format_ctx->nb_streams; ++i) {
-        if (format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-            video_stream_index  = i;
-            video_stream        = format_ctx->streams[i];
-            video_codec_params  = format_ctx->streams[i]->codecpar;
+    else if (PIPE_INPUT::is_pipe(file_path)) {
+        if (!(use_pipe = pipe_input.attach(file_path, format_ctx))) {
+            cerr << "Can't open pipe: " << file_path << endl;
+            return OPEN_INPUT_ERROR;
         }
-        if (format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-            audio_stream_index  = i;
-            audio_stream        = format_ctx->streams[i];
-            audio_codec_params  = format_ctx->streams[i]->codecpar;
+    }
+    else if (load_in_memory) {
+        uint64_t started = SDL_GetPerformanceCounter();
+        if (!memory_input.load_file(file_path, format_ctx)) {
+            cerr << "Can't load input file in memory." << endl;
+            return OPEN_INPUT_ERROR;
         }
+        cout << "Loaded " << memory_input.input_size() / 1024 << " KB in memory in "
+             << (double)(SDL_GetPerformanceCounter() - started) * 1000 / SDL_GetPerformanceFrequency() << " ms." << endl;
     }
-
-    /* Check for sure we found video and audio stream */
-    if (video_stream_index < 0) {
-        cerr << "Can't find video stream." << endl;
-        return VIDEO_STREAM_NOT_FOUND;
+    else if (read_ahead_mb > 0 || !mmap_input.attach(file_path, format_ctx)) {
+        size_t window = (size_t)(read_ahead_mb > 0 ? read_ahead_mb : READ_AHEAD_DEFAULT_WINDOW_MB) * 1024 * 1024;
+        use_read_ahead = read_ahead_input.attach(file_path, format_ctx, window);
     }
 
-    if (audio_stream_index < 0) {
-        cerr << "Can't find audio stream." << endl;
-        return AUDIO_STREAM_NOT_FOUND;
+    apply_probe_settings(format_ctx, probe_settings);
+
+    // Open input file and store data in format_ctx
+    if ((avformat_open_input(&format_ctx, file_path.data(), nullptr, nullptr)) < 0) {
+        cerr << "Can't open input file with given path." << endl;
+        return OPEN_INPUT_ERROR;
     }
 
-    /* Find video and audio decoder */
+    // Find stream info in input file, from cache when "--stream-info-cache" already probed it
+    stream_info_time = STAGE_TIMER::now();
+    if ((ret = stream_info_cache.find_stream_info(format_ctx, file_path, &stream_info_cached)) < 0) return ret;
+    stream_info_time = STAGE_TIMER::now() - stream_info_time;
+    opened = STAGE_TIMER::now();
+
+    // This tutorial only render video, demuxer discard audio and every other stream so their packets are never read
+    if ((ret = select_streams(format_ctx, STREAM_SELECT_VIDEO_ONLY, &video_stream_index, &audio_stream_index)) < 0) return ret;
+    video_stream        = format_ctx->streams[video_stream_index];
+    video_codec_params  = video_stream->codecpar;
+
+    /* Find video decoder, no audio decoder is opened */
     video_codec = avcodec_find_decoder(video_codec_params->codec_id);
     if (video_codec == nullptr) {
         cerr << "Can't find decoder for video with codec: " << avcodec_get_name(video_codec_params->codec_id) << endl;
         return FIND_VIDEO_DECODER_ERROR;
     }
 
-    audio_codec = avcodec_find_decoder(audio_codec_params->codec_id);
-    if (audio_codec == nullptr) {
-        cerr << "Can't find decoder for audio with codec: " << avcodec_get_name(audio_codec_params->codec_id) << endl;
-        return FIND_AUDIO_DECODER_ERROR;
-    }
-
-    /* Set update video and audio codec context */
+    /* Set update video codec context */
     if ((video_codec_ctx = avcodec_alloc_context3(video_codec)) == nullptr) {
         cerr << "Can't alloc video codec context." << endl;
         return ALLOC_VIDEO_CODEC_CTX_ERROR;
     }
 
-    if ((audio_codec_ctx = avcodec_alloc_context3(audio_codec)) == nullptr) {
-        cerr << "Can't alloc audio codec context." << endl;
-        return ALLOC_AUDIO_CODEC_CTX_ERROR;
-    }
-
-    /* Copy video and audio codec params to context */
+    /* Copy video codec params to context */
     if ((avcodec_parameters_to_context(video_codec_ctx, video_codec_params)) < 0) {
         cerr << "Can't copy video codec params to video codec context." << endl;
         return COPY_VIDEO_CODEC_PARAMS_ERROR;
     }
 
-    if ((avcodec_parameters_to_context(audio_codec_ctx, audio_codec_params)) < 0) {
-        cerr << "Can't copy audio codec params to audio codec context." << endl;
-        return COPY_AUDIO_CODEC_PARAMS_ERROR;
+    if ((backend = create_render_backend(backend_name, true)) == nullptr) {
+        cerr << "Unknown render backend: " << backend_name << endl;
+        return CREATE_RENDER_BACKEND_ERROR;
+    }
+
+    /* Choose display size first, frames are decoded in lowres when the codec supports it and then scaled to this size */
+    if ((ret = get_display_size(backend->is_realtime(), max_width, max_height, video_codec_params->width, video_codec_params->height, &display_width, &display_height)) < 0) {
+        return ret;
     }
 
-    /* Now we need open video and audio codec for ready to read and decode video and audio packet */
+    video_codec_ctx->lowres = choose_lowres(video_codec, video_codec_params->width, video_codec_params->height,
+                                            display_width, display_height);
+
+    /* Now we need open video codec for ready to read and decode video packet */
     if (avcodec_open2(video_codec_ctx, video_codec, nullptr) < 0) {
         cerr << "Can't open video codec context." << endl;
         return OPEN_VIDEO_CODEC_ERROR;
     }
 
-    if (avcodec_open2(audio_codec_ctx, audio_codec, nullptr) < 0) {
-        cerr << "Can't open audio codec context." << endl;
-        return OPEN_AUDIO_CODEC_ERROR;
-    }
-
     /* Alloc packet for read packet from input file and frame for receive frame decoded from packet */
     if ((packet = av_packet_alloc()) == nullptr) {
         cerr << "Can't alloc packet." << endl;
@@ -176,34 +265,45 @@ int main(int argc, char *args[]) {
         return ALLOC_FRAME_ERROR;
     }
 
-    /* Get SwsContext for scaling and converting frame data */
-    sws_ctx = sws_getContext(video_codec_ctx->width, video_codec_ctx->height, video_codec_ctx->pix_fmt,
-                             video_codec_ctx->width, video_codec_ctx->height, AV_PIX_FMT_YUV420P,
-                             SWS_BILINEAR, nullptr, nullptr, nullptr);
-    if (sws_ctx == nullptr) {
-        cerr << "Can't get sws context." << endl;
-        return GET_SWS_CTX_ERROR;
+    /* Get SwsContext for scaling and converting frame data, big frames are converted in parallel slices */
+    int scaler_slices = SLICED_SCALER::choose_slice_count(video_codec_ctx->width, video_codec_ctx->height, display_height,
+                                                          av_q2d(av_guess_frame_rate(format_ctx, video_stream, nullptr)));
+    ret = scaler.init(video_codec_ctx->width, video_codec_ctx->height, video_codec_ctx->pix_fmt,
+                      display_width, display_height, AV_PIX_FMT_YUV420P, scaler_slices);
+    if (ret < 0) {
+        return ret;
     }
+    cout << "Converting frames in " << scaler.slices() << " slice(s)." << endl;
+    cout << "Decoding " << video_codec_ctx->width << "x" << video_codec_ctx->height << " (lowres " << video_codec_ctx->lowres
+         << "), displaying " << display_width << "x" << display_height << ", uploading "
+         << av_image_get_buffer_size(AV_PIX_FMT_YUV420P, display_width, display_height, 1) << " bytes per frame." << endl;
 
     /* Alloc memory for store yuv420 data */
-    ret = av_image_alloc(yuv420_frame, yuv420_frame_linesize, video_codec_ctx->width, video_codec_ctx->height, AV_PIX_FMT_YUV420P, 1);
+    ret = av_image_alloc(yuv420_frame, yuv420_frame_linesize, display_width, display_height, AV_PIX_FMT_YUV420P, 1);
     if (ret < 0) {
         cerr << "Can't alloc memory for RGB frame" << endl;
         return ALLOC_RGB_FRAME_ERROR;
     }
 
-    // Init SDL library for output frame on screen
-    if ((ret = init_sdl(video_codec_ctx->width, video_codec_ctx->height)) < 0) {
+    // Init render backend for output frame
+    if ((ret = backend->init(display_width, display_height)) < 0) {
         return ret;
     }
+    cout << "Rendering with " << backend->name() << " backend." << endl;
 
     // Read packet and decode into frame
-    while (av_read_frame(format_ctx, packet) >= 0) {
+    for (;;) {
+        Uint64 stage_begin = STAGE_TIMER::now();
+        if (av_read_frame(format_ctx, packet) < 0) break;
+        stage_timer.add(STAGE_DEMUX, stage_begin);
+
         if (quit) break;
 
         // Video stream
         if (packet->stream_index == video_stream_index) {
+            stage_begin = STAGE_TIMER::now();
             ret = avcodec_send_packet(video_codec_ctx, packet);
+            stage_timer.add(STAGE_DECODE, stage_begin);
 
             if (ret == AVERROR_EOF) break;
 
@@ -213,7 +313,9 @@ int main(int argc, char *args[]) {
             }
 
             while (ret >= 0) {
+                stage_begin = STAGE_TIMER::now();
                 ret = avcodec_receive_frame(video_codec_ctx, frame);
+                stage_timer.add(STAGE_DECODE, stage_begin);
 
                 if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
                 else if (ret < 0) {
@@ -221,57 +323,50 @@ int main(int argc, char *args[]) {
                     return SEND_VIDEO_FRAME_ERROR;
                 }
 
-                if (video_codec_ctx->pix_fmt != AV_PIX_FMT_YUV420P) {
+                if (video_codec_ctx->pix_fmt != AV_PIX_FMT_YUV420P
+                    || video_codec_ctx->width != display_width || video_codec_ctx->height != display_height) {
                     /* Convert frame pixel format to RGB24 format */
-                    sws_scale(sws_ctx, frame->data, frame->linesize, 0, video_codec_ctx->height, yuv420_frame, yuv420_frame_linesize);
-                    SDL_UpdateYUVTexture(texture, nullptr,
-                                         yuv420_frame[0], yuv420_frame_linesize[0],
-                                         yuv420_frame[1], yuv420_frame_linesize[1],
-                                         yuv420_frame[2], yuv420_frame_linesize[2]);
+                    stage_begin = STAGE_TIMER::now();
+                    scaler.scale(frame->data, frame->linesize, yuv420_frame, yuv420_frame_linesize);
+                    stage_timer.add(STAGE_CONVERT, stage_begin);
+
+                    stage_begin = STAGE_TIMER::now();
+                    backend->upload(yuv420_frame, yuv420_frame_linesize);
+                    stage_timer.add(STAGE_UPLOAD, stage_begin);
                 }
                 else {
-                    SDL_UpdateYUVTexture(texture, nullptr,
-                                         frame->data[0], frame->linesize[0],
-                                         frame->data[1], frame->linesize[1],
-                                         frame->data[2], frame->linesize[2]);
+                    stage_begin = STAGE_TIMER::now();
+                    backend->upload(frame->data, frame->linesize);
+                    stage_timer.add(STAGE_UPLOAD, stage_begin);
                 }
 
-                // Clear renderer
-                SDL_RenderClear(renderer);
-
-                // Copy texture to renderer
-                SDL_RenderCopy(renderer, texture, nullptr, &display_rect);
-
-                // Rendering video frame
-                SDL_RenderPresent(renderer);
+                stage_begin = STAGE_TIMER::now();
+                backend->present();
+                stage_timer.add(STAGE_PRESENT, stage_begin);
+                if (presented_frames == 0) print_time_to_first_frame(launched, stream_info_time, stream_info_cached);
+                if (use_pipe) pipe_input.record_latency(frame->pkt_pos);
+                presented_frames++;
 
                 av_frame_unref(frame);
             }
 
         }
 
-        // Audio stream
-        if (packet->stream_index == audio_stream_index) {
-
-        }
-
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT) quit = true;
-        }
+        if (backend->poll_quit()) quit = true;
 
         av_packet_unref(packet);
     }
 
+    stage_timer.report(presented_frames);
+    if (use_read_ahead) read_ahead_input.report();
+    if (use_pipe) pipe_input.report(opened);
+
     av_frame_free(&frame);
     av_packet_free(&packet);
     avcodec_free_context(&video_codec_ctx);
-    avcodec_free_context(&audio_codec_ctx);
-    sws_freeContext(sws_ctx);
     avformat_free_context(format_ctx);
 
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyTexture(texture);
-    SDL_DestroyWindow(window);
+    delete backend;
     cout << "COMPLETE" << endl;
 
     return 0;
@@ -0,0 +1,222 @@
+#ifndef TUTORIAL_02_MMAP_INPUT_H
+#define TUTORIAL_02_MMAP_INPUT_H
+
+#include "iostream"
+#include "string"
+#include "cstring"
+#include "algorithm"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "windows.h"
+#else
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#endif
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavformat/avio.h"
+#include "libavutil/mem.h"
+}
+
+// Size of AVIOContext buffer, reads are served from the mapping so it only need to hold one demuxer request
+const int MMAP_INPUT_BUFFER_SIZE = 64 * 1024;
+
+// Bytes ahead of read position the kernel is asked to page in
+const size_t MMAP_INPUT_WILLNEED_WINDOW = 8 * 1024 * 1024;
+
+/**
+ * Local file mapped into memory and served to the demuxer through a custom AVIOContext.
+ *
+ * @note Read callback copy bytes straight from the mapping, there is no read() syscall per buffer. The mapping is
+ *       advised sequential and the window ahead of read position is advised "will need", so pages are read in before
+ *       demuxer touch them. Advice is not available on Windows, where the mapping alone is used.
+ */
+struct MMAP_INPUT {
+private:
+    const uint8_t *data;
+    int64_t size;
+    int64_t position;
+    int64_t advised_start;
+    int64_t advised_end;
+    AVIOContext *avio_ctx;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+    /**
+     * Ask kernel to page in window after position, once per window.
+     */
+    void advise_ahead() {
+#ifndef _WIN32
+        if (this->position >= this->advised_start
+            && this->position + (int64_t)MMAP_INPUT_WILLNEED_WINDOW / 2 < this->advised_end) return;
+
+        long page_size = sysconf(_SC_PAGESIZE);
+        int64_t start = this->position & ~((int64_t)page_size - 1);
+        int64_t end = std::min(this->size, this->position + (int64_t)MMAP_INPUT_WILLNEED_WINDOW);
+        if (end > start) madvise((void*)(this->data + start), (size_t)(end - start), MADV_WILLNEED);
+
+        this->advised_start = start;
+        this->advised_end = end;
+#endif
+    }
+
+    static int read_packet(void *opaque, uint8_t *buffer, int buffer_size) {
+        auto *input = (MMAP_INPUT*)opaque;
+
+        int64_t left = input->size - input->position;
+        if (left <= 0) return AVERROR_EOF;
+
+        int size = (int)std::min((int64_t)buffer_size, left);
+        memcpy(buffer, input->data + input->position, size);
+        input->position += size;
+        input->advise_ahead();
+
+        return size;
+    }
+
+    static int64_t seek(void *opaque, int64_t offset, int whence) {
+        auto *input = (MMAP_INPUT*)opaque;
+        int64_t position;
+
+        switch (whence & ~AVSEEK_FORCE) {
+            case AVSEEK_SIZE:   return input->size;
+            case SEEK_SET:      position = offset; break;
+            case SEEK_CUR:      position = input->position + offset; break;
+            case SEEK_END:      position = input->size + offset; break;
+            default:            return AVERROR(EINVAL);
+        }
+
+        if (position < 0 || position > input->size) return AVERROR(EINVAL);
+
+        input->position = position;
+        input->advise_ahead();
+        return position;
+    }
+
+    void unmap() {
+#ifdef _WIN32
+        if (this->data) UnmapViewOfFile(this->data);
+        if (this->mapping) CloseHandle(this->mapping);
+        if (this->file != INVALID_HANDLE_VALUE) CloseHandle(this->file);
+        this->mapping = nullptr;
+        this->file = INVALID_HANDLE_VALUE;
+#else
+        if (this->data) munmap((void*)this->data, (size_t)this->size);
+#endif
+        this->data = nullptr;
+        this->size = 0;
+    }
+
+    bool map(const std::string &path) {
+#ifdef _WIN32
+        this->file = CreateFileA(path.data(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                 FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (this->file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(this->file, &file_size) || file_size.QuadPart == 0) return false;
+
+        this->mapping = CreateFileMappingA(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (this->mapping == nullptr) return false;
+
+        this->data = (const uint8_t*)MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+        this->size = file_size.QuadPart;
+        return this->data != nullptr;
+#else
+        int fd = ::open(path.data(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat info = {};
+        if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+
+        void *mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) return false;
+
+        madvise(mapping, (size_t)info.st_size, MADV_SEQUENTIAL);
+        this->data = (const uint8_t*)mapping;
+        this->size = info.st_size;
+        return true;
+#endif
+    }
+
+public:
+    MMAP_INPUT() {
+        this->data          = nullptr;
+        this->size          = 0;
+        this->position      = 0;
+        this->advised_start = 0;
+        this->advised_end   = 0;
+        this->avio_ctx      = nullptr;
+#ifdef _WIN32
+        this->file          = INVALID_HANDLE_VALUE;
+        this->mapping       = nullptr;
+#endif
+    }
+
+    /**
+     * Must be destroyed after the format context using it is closed.
+     */
+    ~MMAP_INPUT() {
+        if (this->avio_ctx) {
+            av_freep(&this->avio_ctx->buffer);
+            avio_context_free(&this->avio_ctx);
+        }
+        unmap();
+    }
+
+    MMAP_INPUT(const MMAP_INPUT&) = delete;
+    MMAP_INPUT &operator=(const MMAP_INPUT&) = delete;
+
+    /**
+     * Map file and make format context read from the mapping.
+     * @param path path of local file.
+     * @param format_ctx format context not opened yet, from avformat_alloc_context.
+     * @return true when input is mapped, false when file can't be mapped (e.g. it is a pipe or a URL) and format
+     *         context is left untouched.
+     */
+    bool attach(const std::string &path, AVFormatContext *format_ctx) {
+        if (!map(path)) {
+            unmap();
+            return false;
+        }
+
+        auto *buffer = (uint8_t*)av_malloc(MMAP_INPUT_BUFFER_SIZE);
+        if (buffer == nullptr) {
+            unmap();
+            return false;
+        }
+
+        this->avio_ctx = avio_alloc_context(buffer, MMAP_INPUT_BUFFER_SIZE, 0, this, read_packet, nullptr, seek);
+        if (this->avio_ctx == nullptr) {
+            av_free(buffer);
+            unmap();
+            return false;
+        }
+
+        advise_ahead();
+        format_ctx->pb = this->avio_ctx;
+        format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+        return true;
+    }
+
+    /**
+     * Get size of mapped file.
+     */
+    int64_t file_size() const {
+        return this->size;
+    }
+};
+
+#endif //TUTORIAL_02_MMAP_INPUT_H
@@ -0,0 +1,227 @@
+#ifndef TUTORIAL_02_PIPE_INPUT_H
+#define TUTORIAL_02_PIPE_INPUT_H
+
+#include "iostream"
+#include "string"
+#include "deque"
+#include "algorithm"
+#include "cerrno"
+#include "SDL.h"
+
+#ifdef _WIN32
+#include "io.h"
+#include "fcntl.h"
+#else
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/stat.h"
+#endif
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavformat/avio.h"
+#include "libavutil/mem.h"
+}
+
+// Size of AVIOContext buffer for pipes, big enough to take a whole burst of writer in one read
+const int PIPE_INPUT_BUFFER_SIZE = 1024 * 1024;
+
+// Read offsets remembered with their arrival time, older are forgotten
+const size_t PIPE_INPUT_MAX_ARRIVALS = 4096;
+
+// Frames presented before latency is taken as steady, startup burst and probing skew the first ones
+const long PIPE_INPUT_WARMUP_FRAMES = 30;
+
+/**
+ * Non-seekable input (stdin, FIFO) served to the demuxer through a custom AVIOContext, with input latency measurement.
+ *
+ * @note AVIOContext is not seekable and has no seek callback, so probing never seek back: libavformat rewind inside
+ *       the probe data it kept instead. Read callback return whatever the pipe hold instead of waiting for a full
+ *       buffer, and format context get "nobuffer" and "flush_packets" flags so packets are given out as soon as they
+ *       are parsed. "nobuffer" mean packets read while probing stream info are dropped, keep probing short with
+ *       "--probesize" and "--analyzeduration". Every read remember at which input offset and time bytes arrived, so
+ *       latency of a presented frame is the time since bytes of its packet came out of the pipe.
+ */
+struct PIPE_INPUT {
+private:
+    struct ARRIVAL {
+        int64_t end;                // Input offset just after bytes of this read
+        Uint64 time;                // When read returned
+    };
+
+    int fd;
+    bool owns_fd;
+    int64_t position;
+    AVIOContext *avio_ctx;
+    std::deque<ARRIVAL> arrivals;
+    SDL_mutex *mutex;
+    Uint64 attached;
+    Uint64 first_byte;
+    long latency_frames;
+    double latency_total;
+    double latency_max;
+
+    static int read_packet(void *opaque, uint8_t *buffer, int buffer_size) {
+        auto *input = (PIPE_INPUT*)opaque;
+        int read_size;
+
+        do {
+#ifdef _WIN32
+            read_size = _read(input->fd, buffer, (unsigned int)buffer_size);
+#else
+            read_size = (int)::read(input->fd, buffer, (size_t)buffer_size);
+#endif
+        } while (read_size < 0 && errno == EINTR);
+
+        if (read_size == 0) return AVERROR_EOF;
+        if (read_size < 0) return AVERROR(errno);
+
+        Uint64 now = SDL_GetPerformanceCounter();
+
+        SDL_LockMutex(input->mutex);
+        if (input->first_byte == 0) input->first_byte = now;
+        input->position += read_size;
+        input->arrivals.push_back({input->position, now});
+        if (input->arrivals.size() > PIPE_INPUT_MAX_ARRIVALS) input->arrivals.pop_front();
+        SDL_UnlockMutex(input->mutex);
+
+        return read_size;
+    }
+
+    static double elapsed_ms(Uint64 from, Uint64 to) {
+        return (double)(to - from) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    }
+
+public:
+    PIPE_INPUT() {
+        this->fd                = -1;
+        this->owns_fd           = false;
+        this->position          = 0;
+        this->avio_ctx          = nullptr;
+        this->mutex             = SDL_CreateMutex();
+        this->attached          = 0;
+        this->first_byte        = 0;
+        this->latency_frames    = 0;
+        this->latency_total     = 0.0;
+        this->latency_max       = 0.0;
+    }
+
+    /**
+     * Must be destroyed after the format context using it is closed.
+     */
+    ~PIPE_INPUT() {
+        if (this->avio_ctx) {
+            av_freep(&this->avio_ctx->buffer);
+            avio_context_free(&this->avio_ctx);
+        }
+#ifdef _WIN32
+        if (this->owns_fd) _close(this->fd);
+#else
+        if (this->owns_fd) ::close(this->fd);
+#endif
+        SDL_DestroyMutex(this->mutex);
+    }
+
+    PIPE_INPUT(const PIPE_INPUT&) = delete;
+    PIPE_INPUT &operator=(const PIPE_INPUT&) = delete;
+
+    /**
+     * Check if path is standard input ("-" or "pipe:") or a named pipe.
+     * @param path path given on command line.
+     * @return true when input can only be read forward.
+     */
+    static bool is_pipe(const std::string &path) {
+        if (path == "-" || path.compare(0, 5, "pipe:") == 0) return true;
+#ifdef _WIN32
+        return path.compare(0, 9, "\\\\.\\pipe\\") == 0;
+#else
+        struct stat info = {};
+        return stat(path.data(), &info) == 0 && S_ISFIFO(info.st_mode);
+#endif
+    }
+
+    /**
+     * Make format context read from pipe without seeking and with low-delay demux flags.
+     * @param path "-" or "pipe:" for standard input ("pipe:N" for descriptor N), otherwise path of a named pipe.
+     * @param format_ctx format context not opened yet, from avformat_alloc_context.
+     * @return true when input is set up, false when pipe can't be opened and format context is left untouched.
+     */
+    bool attach(const std::string &path, AVFormatContext *format_ctx) {
+        this->attached = SDL_GetPerformanceCounter();
+
+        if (path == "-" || path == "pipe:") {
+            this->fd = 0;
+        }
+        else if (path.compare(0, 5, "pipe:") == 0) {
+            this->fd = atoi(path.data() + 5);
+        }
+        else {
+#ifdef _WIN32
+            this->fd = _open(path.data(), _O_RDONLY | _O_BINARY);
+#else
+            this->fd = open(path.data(), O_RDONLY);
+#endif
+            if (this->fd < 0) return false;
+            this->owns_fd = true;
+        }
+#ifdef _WIN32
+        _setmode(this->fd, _O_BINARY);
+#endif
+
+        auto *buffer = (uint8_t*)av_malloc(PIPE_INPUT_BUFFER_SIZE);
+        if (buffer == nullptr) return false;
+
+        this->avio_ctx = avio_alloc_context(buffer, PIPE_INPUT_BUFFER_SIZE, 0, this, read_packet, nullptr, nullptr);
+        if (this->avio_ctx == nullptr) {
+            av_free(buffer);
+            return false;
+        }
+        this->avio_ctx->seekable = 0;
+
+        format_ctx->pb = this->avio_ctx;
+        format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO | AVFMT_FLAG_NOBUFFER | AVFMT_FLAG_FLUSH_PACKETS;
+        return true;
+    }
+
+    /**
+     * Record latency of a presented frame, from arrival of its packet to now.
+     * @param packet_position input offset of packet the frame was decoded from ("pkt_pos"), ignored when negative.
+     */
+    void record_latency(int64_t packet_position) {
+        if (packet_position < 0) return;
+
+        Uint64 now = SDL_GetPerformanceCounter();
+
+        SDL_LockMutex(this->mutex);
+        auto arrival = std::upper_bound(this->arrivals.begin(), this->arrivals.end(), packet_position,
+                                        [](int64_t position, const ARRIVAL &read) { return position < read.end; });
+        if (arrival != this->arrivals.end() && arrival->time <= now) {
+            if (++this->latency_frames > PIPE_INPUT_WARMUP_FRAMES) {
+                double latency = elapsed_ms(arrival->time, now);
+                this->latency_total += latency;
+                this->latency_max = std::max(this->latency_max, latency);
+            }
+        }
+        SDL_UnlockMutex(this->mutex);
+    }
+
+    /**
+     * Print startup and steady-state latency of pipe input.
+     * @param opened time avformat_open_input and stream info returned, from SDL_GetPerformanceCounter.
+     */
+    void report(Uint64 opened) {
+        SDL_LockMutex(this->mutex);
+        std::cout << "Pipe input: first byte after " << (this->first_byte ? elapsed_ms(this->attached, this->first_byte) : 0.0)
+                  << " ms, opened after " << elapsed_ms(this->attached, opened) << " ms, " << this->position / 1024
+                  << " KB read." << std::endl;
+
+        long steady_frames = this->latency_frames - PIPE_INPUT_WARMUP_FRAMES;
+        if (steady_frames > 0) {
+            std::cout << "Pipe latency from arrival to present: " << this->latency_total / (double)steady_frames
+                      << " ms average, " << this->latency_max << " ms max over " << steady_frames << " frames." << std::endl;
+        }
+        SDL_UnlockMutex(this->mutex);
+    }
+};
+
+#endif //TUTORIAL_02_PIPE_INPUT_H
@@ -0,0 +1,280 @@
+#ifndef TUTORIAL_02_READ_AHEAD_INPUT_H
+#define TUTORIAL_02_READ_AHEAD_INPUT_H
+
+#include "iostream"
+#include "string"
+#include "vector"
+#include "cstring"
+#include "algorithm"
+#include "SDL.h"
+#include "SDL_thread.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavformat/avio.h"
+#include "libavutil/mem.h"
+}
+
+// Size of each buffer of the ring, one read of underlying input fill one buffer
+const int READ_AHEAD_BLOCK_SIZE = 256 * 1024;
+
+// Read-ahead window used when none is given on command line, in MB
+const int READ_AHEAD_DEFAULT_WINDOW_MB = 8;
+
+/**
+ * Input read on a dedicated I/O thread into a ring of buffers, demuxer is served through a custom AVIOContext.
+ *
+ * @note The I/O thread keep the ring full so slow reads (cold cache, network, disk contention) overlap with decoding
+ *       instead of stalling it. Seeking inside data already in the ring only drop buffers, any other seek clear the
+ *       ring and restart reading from the new position. Any protocol supported by avio_open2 can be read ahead.
+ */
+struct READ_AHEAD_INPUT {
+private:
+    struct BLOCK {
+        std::vector<uint8_t> data;
+        int size;
+    };
+
+    AVIOContext *source;
+    AVIOContext *avio_ctx;
+    int64_t size;               // Size of input, negative when unknown
+    std::vector<BLOCK> blocks;
+    size_t head;                // First filled block
+    size_t count;               // Number of filled blocks
+    int head_offset;            // Bytes of head block already given to demuxer
+    int64_t position;           // Offset of next byte given to demuxer
+    int64_t fill_position;      // Offset of next byte read from source
+    uint64_t generation;        // Bumped by every seek which clear the ring
+    bool eof;
+    int error;
+    bool aborted;
+    long stalls;                // Reads which had to wait for I/O thread
+    SDL_Thread *thread;
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+
+    static int io_thread(void *userdata) {
+        auto *input = (READ_AHEAD_INPUT*)userdata;
+        int64_t source_position = 0;
+
+        SDL_LockMutex(input->mutex);
+        while (!input->aborted) {
+            if (input->count == input->blocks.size() || input->eof || input->error < 0) {
+                SDL_CondWait(input->cond, input->mutex);
+                continue;
+            }
+
+            uint64_t generation = input->generation;
+            int64_t offset = input->fill_position;
+            BLOCK *block = &input->blocks[(input->head + input->count) % input->blocks.size()];
+            SDL_UnlockMutex(input->mutex);
+
+            // Only I/O thread touch source and empty blocks, so reading is done without the lock
+            int size = 0;
+            if (offset != source_position) source_position = avio_seek(input->source, offset, SEEK_SET);
+            if (source_position < 0) size = (int)source_position;
+            else size = avio_read(input->source, block->data.data(), READ_AHEAD_BLOCK_SIZE);
+            if (size > 0) source_position += size;
+
+            SDL_LockMutex(input->mutex);
+            if (generation != input->generation) continue;
+
+            if (size > 0) {
+                block->size = size;
+                input->count++;
+                input->fill_position += size;
+            }
+            else if (size == 0 || size == AVERROR_EOF) {
+                input->eof = true;
+            }
+            else {
+                input->error = size;
+            }
+            SDL_CondBroadcast(input->cond);
+        }
+        SDL_UnlockMutex(input->mutex);
+
+        return 0;
+    }
+
+    /**
+     * Drop head block once demuxer consumed it, must be called with the lock held.
+     */
+    void release_head() {
+        this->head = (this->head + 1) % this->blocks.size();
+        this->count--;
+        this->head_offset = 0;
+        SDL_CondBroadcast(this->cond);
+    }
+
+    static int read_packet(void *opaque, uint8_t *buffer, int buffer_size) {
+        auto *input = (READ_AHEAD_INPUT*)opaque;
+
+        SDL_LockMutex(input->mutex);
+        if (input->count == 0 && !input->eof && input->error == 0) input->stalls++;
+        while (input->count == 0 && !input->eof && input->error == 0 && !input->aborted) {
+            SDL_CondWait(input->cond, input->mutex);
+        }
+
+        if (input->count == 0) {
+            int ret = input->error < 0 ? input->error : AVERROR_EOF;
+            SDL_UnlockMutex(input->mutex);
+            return ret;
+        }
+
+        BLOCK *block = &input->blocks[input->head];
+        int size = std::min(buffer_size, block->size - input->head_offset);
+        const uint8_t *data = block->data.data() + input->head_offset;
+        SDL_UnlockMutex(input->mutex);
+
+        // Filled blocks are never written by I/O thread
+        memcpy(buffer, data, size);
+
+        SDL_LockMutex(input->mutex);
+        input->head_offset += size;
+        input->position += size;
+        if (input->head_offset == block->size) input->release_head();
+        SDL_UnlockMutex(input->mutex);
+
+        return size;
+    }
+
+    static int64_t seek(void *opaque, int64_t offset, int whence) {
+        auto *input = (READ_AHEAD_INPUT*)opaque;
+        int64_t position;
+
+        // Source is owned by I/O thread, so its size is only asked once in "attach"
+        if ((whence & ~AVSEEK_FORCE) == AVSEEK_SIZE) return input->size;
+
+        SDL_LockMutex(input->mutex);
+        switch (whence & ~AVSEEK_FORCE) {
+            case SEEK_SET:  position = offset; break;
+            case SEEK_CUR:  position = input->position + offset; break;
+            case SEEK_END:  position = input->size >= 0 ? input->size + offset : -1; break;
+            default:        position = -1; break;
+        }
+
+        if (position < 0 || !(input->source->seekable & AVIO_SEEKABLE_NORMAL)) {
+            SDL_UnlockMutex(input->mutex);
+            return AVERROR(EINVAL);
+        }
+
+        if (position >= input->position && position < input->fill_position) {
+            // Target is already in the ring, drop what is before it
+            while (input->position < position) {
+                BLOCK *block = &input->blocks[input->head];
+                int skip = (int)std::min((int64_t)(block->size - input->head_offset), position - input->position);
+
+                input->head_offset += skip;
+                input->position += skip;
+                if (input->head_offset == block->size) input->release_head();
+            }
+        }
+        else {
+            input->generation++;
+            input->head             = 0;
+            input->count            = 0;
+            input->head_offset      = 0;
+            input->position         = position;
+            input->fill_position    = position;
+            input->eof              = false;
+            input->error            = 0;
+            SDL_CondBroadcast(input->cond);
+        }
+        SDL_UnlockMutex(input->mutex);
+
+        return position;
+    }
+
+public:
+    READ_AHEAD_INPUT() {
+        this->source        = nullptr;
+        this->avio_ctx      = nullptr;
+        this->size          = -1;
+        this->head          = 0;
+        this->count         = 0;
+        this->head_offset   = 0;
+        this->position      = 0;
+        this->fill_position = 0;
+        this->generation    = 0;
+        this->eof           = false;
+        this->error         = 0;
+        this->aborted       = false;
+        this->stalls        = 0;
+        this->thread        = nullptr;
+        this->mutex         = SDL_CreateMutex();
+        this->cond          = SDL_CreateCond();
+    }
+
+    /**
+     * Must be destroyed after the format context using it is closed.
+     */
+    ~READ_AHEAD_INPUT() {
+        SDL_LockMutex(this->mutex);
+        this->aborted = true;
+        SDL_CondBroadcast(this->cond);
+        SDL_UnlockMutex(this->mutex);
+
+        if (this->thread) SDL_WaitThread(this->thread, nullptr);
+        if (this->avio_ctx) {
+            av_freep(&this->avio_ctx->buffer);
+            avio_context_free(&this->avio_ctx);
+        }
+        avio_closep(&this->source);
+
+        SDL_DestroyCond(this->cond);
+        SDL_DestroyMutex(this->mutex);
+    }
+
+    READ_AHEAD_INPUT(const READ_AHEAD_INPUT&) = delete;
+    READ_AHEAD_INPUT &operator=(const READ_AHEAD_INPUT&) = delete;
+
+    /**
+     * Open input and make format context read it through the I/O thread.
+     * @param url path or URL of input.
+     * @param format_ctx format context not opened yet, from avformat_alloc_context.
+     * @param window bytes read ahead of demuxer, rounded up to a whole number of blocks.
+     * @return true when read-ahead is set up, false when input can't be opened and format context is left untouched.
+     */
+    bool attach(const std::string &url, AVFormatContext *format_ctx, size_t window) {
+        if (avio_open2(&this->source, url.data(), AVIO_FLAG_READ, nullptr, nullptr) < 0) return false;
+        this->size = avio_size(this->source);
+
+        size_t block_count = std::max((size_t)2, (window + READ_AHEAD_BLOCK_SIZE - 1) / READ_AHEAD_BLOCK_SIZE);
+        this->blocks.resize(block_count);
+        for (auto &block : this->blocks) {
+            block.data.resize(READ_AHEAD_BLOCK_SIZE);
+            block.size = 0;
+        }
+
+        auto *buffer = (uint8_t*)av_malloc(READ_AHEAD_BLOCK_SIZE);
+        if (buffer == nullptr) return false;
+
+        this->avio_ctx = avio_alloc_context(buffer, READ_AHEAD_BLOCK_SIZE, 0, this, read_packet, nullptr, seek);
+        if (this->avio_ctx == nullptr) {
+            av_free(buffer);
+            return false;
+        }
+
+        this->avio_ctx->seekable = this->source->seekable;
+        this->thread = SDL_CreateThread(io_thread, "read-ahead", this);
+        if (this->thread == nullptr) {
+            std::cerr << "Can't create read-ahead thread with error: " << SDL_GetError() << std::endl;
+            return false;
+        }
+
+        format_ctx->pb = this->avio_ctx;
+        format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+        return true;
+    }
+
+    /**
+     * Print number of reads demuxer had to wait for.
+     */
+    void report() const {
+        std::cout << "Read-ahead: " << this->blocks.size() << " blocks of " << READ_AHEAD_BLOCK_SIZE / 1024 << " KB, "
+                  << this->stalls << " stalled reads." << std::endl;
+    }
+};
+
+#endif //TUTORIAL_02_READ_AHEAD_INPUT_H
@@ -0,0 +1,274 @@
+#ifndef TUTORIAL_02_SLICED_SCALER_H
+#define TUTORIAL_02_SLICED_SCALER_H
+
+#include "iostream"
+#include "algorithm"
+#include "SDL.h"
+#include "SDL_thread.h"
+#include "error-code.h"
+
+extern "C" {
+#include "libswscale/swscale.h"
+#include "libavutil/pixdesc.h"
+}
+
+// Max number of horizontal slices a frame can be split into
+const int MAX_SCALER_SLICES = 16;
+
+// Frames with (width * height * frame rate) above this are converted in parallel slices (about 1080p at 60 fps)
+const double SLICED_SCALE_PIXEL_RATE = 1920.0 * 1080.0 * 60.0;
+
+// Slice boundaries are aligned to this number of rows so chroma rows are never split
+const int SCALER_SLICE_ALIGN = 16;
+
+/**
+ * Convert (and scale) frame by splitting it into horizontal slices, each slice has its own SwsContext and is converted
+ * on its own worker thread.
+ *
+ * @note With one slice no worker thread is created and "scale" just call sws_scale on caller thread. Frames are only
+ *       sliced when height is kept: a vertical filter would stop at slice rows instead of reading rows of the
+ *       neighbour slice and leave a seam at every boundary, so vertical resizing always use a single context.
+ */
+struct SLICED_SCALER {
+private:
+    struct WORKER {
+        SLICED_SCALER *owner;
+        int index;
+    };
+
+    int slice_count;
+    SwsContext *contexts[MAX_SCALER_SLICES];
+    int src_first_row[MAX_SCALER_SLICES + 1];
+    int dst_first_row[MAX_SCALER_SLICES + 1];
+    const AVPixFmtDescriptor *src_desc;
+    const AVPixFmtDescriptor *dst_desc;
+
+    SDL_Thread *threads[MAX_SCALER_SLICES];
+    WORKER workers[MAX_SCALER_SLICES];
+    SDL_mutex *mutex;
+    SDL_cond *start_cond;
+    SDL_cond *done_cond;
+    int generation;
+    int pending;
+    bool stop;
+
+    /* Current job, only valid while "pending" > 0 */
+    const uint8_t *const *job_src;
+    const int *job_src_linesize;
+    uint8_t *const *job_dst;
+    const int *job_dst_linesize;
+
+    /**
+     * Get row offset of plane for given luma row.
+     */
+    static int plane_row(const AVPixFmtDescriptor *desc, int plane, int row) {
+        return (plane == 1 || plane == 2) ? row >> desc->log2_chroma_h : row;
+    }
+
+    /**
+     * Convert one slice of current job.
+     * @param index slice index.
+     */
+    void scale_slice(int index) {
+        const uint8_t   *src[4]     = {nullptr};
+        uint8_t         *dst[4]     = {nullptr};
+
+        for (int p = 0; p < 4; ++p) {
+            if (this->job_src[p]) {
+                src[p] = this->job_src[p] + plane_row(this->src_desc, p, this->src_first_row[index]) * this->job_src_linesize[p];
+            }
+            if (this->job_dst[p]) {
+                dst[p] = this->job_dst[p] + plane_row(this->dst_desc, p, this->dst_first_row[index]) * this->job_dst_linesize[p];
+            }
+        }
+
+        sws_scale(this->contexts[index], src, this->job_src_linesize,
+                  0, this->src_first_row[index + 1] - this->src_first_row[index],
+                  dst, this->job_dst_linesize);
+    }
+
+    static int worker_thread(void *userdata) {
+        auto *worker = (WORKER*)userdata;
+        SLICED_SCALER *scaler = worker->owner;
+        int seen_generation = 0;
+
+        SDL_LockMutex(scaler->mutex);
+        for (;;) {
+            while (!scaler->stop && scaler->generation == seen_generation) {
+                SDL_CondWait(scaler->start_cond, scaler->mutex);
+            }
+            if (scaler->stop) break;
+
+            seen_generation = scaler->generation;
+            SDL_UnlockMutex(scaler->mutex);
+
+            scaler->scale_slice(worker->index);
+
+            SDL_LockMutex(scaler->mutex);
+            if (--scaler->pending == 0) SDL_CondSignal(scaler->done_cond);
+        }
+        SDL_UnlockMutex(scaler->mutex);
+
+        return 0;
+    }
+
+public:
+    SLICED_SCALER() {
+        this->slice_count       = 0;
+        this->src_desc          = nullptr;
+        this->dst_desc          = nullptr;
+        this->mutex             = SDL_CreateMutex();
+        this->start_cond        = SDL_CreateCond();
+        this->done_cond         = SDL_CreateCond();
+        this->generation        = 0;
+        this->pending           = 0;
+        this->stop              = false;
+        this->job_src           = nullptr;
+        this->job_src_linesize  = nullptr;
+        this->job_dst           = nullptr;
+        this->job_dst_linesize  = nullptr;
+
+        for (int i = 0; i < MAX_SCALER_SLICES; ++i) {
+            this->contexts[i]   = nullptr;
+            this->threads[i]    = nullptr;
+        }
+    }
+
+    ~SLICED_SCALER() {
+        SDL_LockMutex(this->mutex);
+        this->stop = true;
+        SDL_CondBroadcast(this->start_cond);
+        SDL_UnlockMutex(this->mutex);
+
+        for (int i = 0; i < MAX_SCALER_SLICES; ++i) {
+            if (this->threads[i]) SDL_WaitThread(this->threads[i], nullptr);
+            sws_freeContext(this->contexts[i]);
+        }
+
+        SDL_DestroyCond(this->done_cond);
+        SDL_DestroyCond(this->start_cond);
+        SDL_DestroyMutex(this->mutex);
+    }
+
+    /**
+     * Choose number of slices from pixel rate of the video.
+     * @param width width of frame.
+     * @param height height of frame.
+     * @param dst_height height of converted image, frame is only sliced when it is the same as "height".
+     * @param frame_rate frame rate of video, use 0 when unknown.
+     * @return 1 when frame is small enough to convert on caller thread or is resized vertically, otherwise number of
+     *         CPU cores.
+     */
+    static int choose_slice_count(int width, int height, int dst_height, double frame_rate) {
+        if (frame_rate <= 0) frame_rate = 30.0;
+        if ((double)width * height * frame_rate <= SLICED_SCALE_PIXEL_RATE || height != dst_height) return 1;
+
+        int max_slices = height / SCALER_SLICE_ALIGN;
+        return std::max(1, std::min(std::min(SDL_GetCPUCount(), MAX_SCALER_SLICES), max_slices));
+    }
+
+    /**
+     * Get number of slices frame is split into.
+     * @return number of slices.
+     */
+    int slices() const {
+        return this->slice_count;
+    }
+
+    /**
+     * Create SwsContext and worker thread for each slice.
+     * @param slices number of slices, see "choose_slice_count", only one is used when height change.
+     * @return 0 on success or negative error code on failure.
+     */
+    int init(int src_width, int src_height, AVPixelFormat src_format,
+             int dst_width, int dst_height, AVPixelFormat dst_format, int slices) {
+        this->slice_count   = src_height != dst_height
+                              ? 1 : std::max(1, std::min(std::min(slices, MAX_SCALER_SLICES), dst_height / SCALER_SLICE_ALIGN));
+        this->src_desc      = av_pix_fmt_desc_get(src_format);
+        this->dst_desc      = av_pix_fmt_desc_get(dst_format);
+
+        /*
+         * Rows are the same in source and destination, split them evenly and keep every boundary aligned so chroma
+         * rows are not shared between slices. Aligning can put two boundaries on the same row, such empty slices are
+         * dropped
+         */
+        int boundaries = 0;
+        for (int i = 0; i <= this->slice_count; ++i) {
+            int row = dst_height;
+
+            if (i < this->slice_count) {
+                row = (int)((int64_t)dst_height * i / this->slice_count);
+                row -= row % SCALER_SLICE_ALIGN;
+            }
+
+            if (boundaries > 0 && row <= this->dst_first_row[boundaries - 1]) {
+                if (i < this->slice_count) continue;
+                boundaries--;
+            }
+
+            this->src_first_row[boundaries] = row == dst_height ? src_height : row;
+            this->dst_first_row[boundaries] = row;
+            boundaries++;
+        }
+        this->slice_count = std::max(1, boundaries - 1);
+
+        for (int i = 0; i < this->slice_count; ++i) {
+            int src_rows = this->src_first_row[i + 1] - this->src_first_row[i];
+            int dst_rows = this->dst_first_row[i + 1] - this->dst_first_row[i];
+
+            this->contexts[i] = sws_getContext(src_width, src_rows, src_format,
+                                               dst_width, dst_rows, dst_format,
+                                               SWS_BILINEAR, nullptr, nullptr, nullptr);
+            if (this->contexts[i] == nullptr) {
+                std::cerr << "Can't get sws context for slice " << i << "." << std::endl;
+                return GET_SWS_CTX_ERROR;
+            }
+        }
+
+        if (this->slice_count == 1) return 0;
+
+        for (int i = 0; i < this->slice_count; ++i) {
+            this->workers[i].owner = this;
+            this->workers[i].index = i;
+
+            this->threads[i] = SDL_CreateThread(worker_thread, "scaler", &this->workers[i]);
+            if (this->threads[i] == nullptr) {
+                std::cerr << "Can't create scaler thread with error: " << SDL_GetError() << std::endl;
+                return CREATE_SCALER_THREAD_ERROR;
+            }
+        }
+
+        return 0;
+    }
+
+    /**
+     * Convert whole frame, block until every slice is done.
+     * @param src data of source frame.
+     * @param src_linesize linesize of source frame.
+     * @param dst data of destination image.
+     * @param dst_linesize linesize of destination image.
+     */
+    void scale(const uint8_t *const src[], const int src_linesize[], uint8_t *const dst[], const int dst_linesize[]) {
+        this->job_src           = src;
+        this->job_src_linesize  = src_linesize;
+        this->job_dst           = dst;
+        this->job_dst_linesize  = dst_linesize;
+
+        if (this->slice_count == 1) {
+            scale_slice(0);
+            return;
+        }
+
+        SDL_LockMutex(this->mutex);
+        this->pending = this->slice_count;
+        this->generation++;
+        SDL_CondBroadcast(this->start_cond);
+
+        while (this->pending > 0) {
+            SDL_CondWait(this->done_cond, this->mutex);
+        }
+        SDL_UnlockMutex(this->mutex);
+    }
+};
+
+#endif //TUTORIAL_02_SLICED_SCALER_H
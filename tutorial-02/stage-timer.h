@@ -0,0 +1,78 @@
+#ifndef TUTORIAL_02_STAGE_TIMER_H
+#define TUTORIAL_02_STAGE_TIMER_H
+
+#include "iostream"
+#include "SDL.h"
+
+/**
+ * Stages of the pipeline we measure time of.
+ */
+enum PIPELINE_STAGE {
+    STAGE_DEMUX = 0,
+    STAGE_DECODE,
+    STAGE_CONVERT,
+    STAGE_UPLOAD,
+    STAGE_PRESENT,
+    STAGE_COUNT
+};
+
+/**
+ * Accumulate time spent in each stage of the pipeline.
+ *
+ * @note Each stage must only be updated from one thread.
+ */
+struct STAGE_TIMER {
+private:
+    Uint64 totals[STAGE_COUNT];
+    long counts[STAGE_COUNT];
+    Uint64 started;
+
+public:
+    STAGE_TIMER() {
+        for (int i = 0; i < STAGE_COUNT; ++i) {
+            this->totals[i] = 0;
+            this->counts[i] = 0;
+        }
+        this->started = SDL_GetPerformanceCounter();
+    }
+
+    /**
+     * Get current time to pass to "add" later.
+     * @return performance counter.
+     */
+    static Uint64 now() {
+        return SDL_GetPerformanceCounter();
+    }
+
+    /**
+     * Add time from "begin" until now to given stage.
+     * @param stage one of PIPELINE_STAGE.
+     * @param begin value returned from "now" when stage began.
+     */
+    void add(int stage, Uint64 begin) {
+        this->totals[stage] += SDL_GetPerformanceCounter() - begin;
+        this->counts[stage]++;
+    }
+
+    /**
+     * Print total and average time of each stage and throughput of whole run.
+     * @param frames number of frames went through the pipeline.
+     */
+    void report(long frames) const {
+        static const char *STAGE_NAMES[STAGE_COUNT] = {"demux", "decode", "convert", "upload", "present"};
+        double frequency = (double)SDL_GetPerformanceFrequency();
+        double elapsed = (double)(SDL_GetPerformanceCounter() - this->started) / frequency;
+
+        for (int i = 0; i < STAGE_COUNT; ++i) {
+            double total_ms = (double)this->totals[i] / frequency * 1000.0;
+
+            std::cout << "Stage " << STAGE_NAMES[i] << ": " << total_ms << " ms total, "
+                      << (this->counts[i] ? total_ms / this->counts[i] : 0.0) << " ms per call ("
+                      << this->counts[i] << " calls)" << std::endl;
+        }
+
+        std::cout << frames << " frames in " << elapsed << " s (" << (elapsed > 0 ? frames / elapsed : 0.0) << " fps)" << std::endl;
+    }
+};
+
+#endif //TUTORIAL_02_STAGE_TIMER_H
@@ -0,0 +1,234 @@
+#ifndef TUTORIAL_03_DEMUXER_H
+#define TUTORIAL_03_DEMUXER_H
+
+#include "iostream"
+#include "algorithm"
+#include "SDL.h"
+#include "SDL_thread.h"
+#include "error-code.h"
+#include "packet-queue.h"
+#include "stage-timer.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+}
+
+// Media time buffered ahead of playback when none is given on command line, in seconds
+const double DEMUX_DEFAULT_BUFFER_SECONDS = 2.0;
+
+// Demuxing resume once buffered time fall under this part of the target
+const double DEMUX_LOW_WATER_RATIO = 0.5;
+
+// Bytes buffered at most whatever the duration, keep memory bounded when packets carry no timestamps
+const int DEMUX_MAX_BUFFER_BYTES = 64 * 1024 * 1024;
+
+// Max time demux thread sleep before checking queues again, a missed wake up only cost this
+const Uint32 DEMUX_POLL_MS = 10;
+
+/**
+ * Read packets on a dedicated thread into video and audio packet queues, ahead of playback by a target duration.
+ *
+ * @note Demuxing run until the longest queue hold "target" seconds, then sleep until consumers drain queues under the
+ *       low-water mark. So a slow or bursty read (cold cache, network) is absorbed by the buffer instead of reaching
+ *       the decoder, and demuxing does not wake up for every packet consumed.
+ */
+struct DEMUXER {
+private:
+    AVFormatContext *format_ctx;
+    int video_stream_index;
+    int audio_stream_index;
+    PACKET_QUEUE *video_queue;
+    PACKET_QUEUE *audio_queue;
+    STAGE_TIMER *stage_timer;
+    double target;
+    double low_water;
+    bool aborted;
+    bool finished;
+    int error;
+    long sleeps;                // Times buffer reached target
+    long underruns;             // Reads done while a queue was empty, after buffer was first full
+    SDL_Thread *thread;
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+
+    double buffered() const {
+        double video_time = this->video_stream_index >= 0 ? this->video_queue->duration() : 0.0;
+        double audio_time = this->audio_stream_index >= 0 ? this->audio_queue->duration() : 0.0;
+        return std::max(video_time, audio_time);
+    }
+
+    int buffered_bytes() const {
+        return this->video_queue->size() + this->audio_queue->size();
+    }
+
+    bool is_aborted() {
+        SDL_LockMutex(this->mutex);
+        bool aborted = this->aborted;
+        SDL_UnlockMutex(this->mutex);
+
+        return aborted;
+    }
+
+    /**
+     * Sleep until buffered time fall under low-water mark, must be called with the lock held.
+     */
+    void wait_for_drain() {
+        this->sleeps++;
+        while (!this->aborted && (this->buffered() > this->low_water || this->buffered_bytes() >= DEMUX_MAX_BUFFER_BYTES)) {
+            SDL_CondWaitTimeout(this->cond, this->mutex, DEMUX_POLL_MS);
+        }
+    }
+
+    static int demux_thread(void *userdata) {
+        auto *demuxer = (DEMUXER*)userdata;
+        AVPacket *packet = av_packet_alloc();
+
+        if (packet == nullptr) {
+            std::cerr << "Can't alloc packet." << std::endl;
+            demuxer->error = ALLOC_PACKET_ERROR;
+        }
+
+        while (packet != nullptr && !demuxer->is_aborted()) {
+            if (demuxer->buffered() >= demuxer->target || demuxer->buffered_bytes() >= DEMUX_MAX_BUFFER_BYTES) {
+                SDL_LockMutex(demuxer->mutex);
+                demuxer->wait_for_drain();
+                SDL_UnlockMutex(demuxer->mutex);
+                continue;
+            }
+
+            // Once buffer has been full, an empty queue mean a consumer was starved by slow reads
+            bool video_empty = demuxer->video_stream_index >= 0 && demuxer->video_queue->length() == 0;
+            bool audio_empty = demuxer->audio_stream_index >= 0 && demuxer->audio_queue->length() == 0;
+            if (demuxer->sleeps > 0 && (video_empty || audio_empty)) demuxer->underruns++;
+
+            Uint64 stage_begin = STAGE_TIMER::now();
+            int ret = av_read_frame(demuxer->format_ctx, packet);
+            demuxer->stage_timer->add(STAGE_DEMUX, stage_begin);
+
+            if (ret == AVERROR_EOF) break;
+            if (ret < 0) {
+                std::cerr << "Can't read packet from input." << std::endl;
+                demuxer->error = READ_PACKET_ERROR;
+                break;
+            }
+
+            // Queues take over the packet reference
+            if (packet->stream_index == demuxer->video_stream_index) demuxer->video_queue->push(packet);
+            else if (packet->stream_index == demuxer->audio_stream_index) demuxer->audio_queue->push(packet);
+            else av_packet_unref(packet);
+        }
+
+        av_packet_free(&packet);
+        demuxer->video_queue->finish();
+        demuxer->audio_queue->finish();
+
+        SDL_LockMutex(demuxer->mutex);
+        demuxer->finished = true;
+        SDL_UnlockMutex(demuxer->mutex);
+        return 0;
+    }
+
+public:
+    /**
+     * @param format_ctx opened input, only read by demux thread once started.
+     * @param video_stream_index index of video stream, -1 when video is not played.
+     * @param audio_stream_index index of audio stream, -1 when audio is not played.
+     * @param video_queue queue receiving video packets.
+     * @param audio_queue queue receiving audio packets.
+     * @param stage_timer timer receiving demux time.
+     */
+    DEMUXER(AVFormatContext *format_ctx, int video_stream_index, int audio_stream_index, PACKET_QUEUE *video_queue,
+            PACKET_QUEUE *audio_queue, STAGE_TIMER *stage_timer) {
+        this->format_ctx            = format_ctx;
+        this->video_stream_index    = video_stream_index;
+        this->audio_stream_index    = audio_stream_index;
+        this->video_queue           = video_queue;
+        this->audio_queue           = audio_queue;
+        this->stage_timer           = stage_timer;
+        this->target                = DEMUX_DEFAULT_BUFFER_SECONDS;
+        this->low_water             = DEMUX_DEFAULT_BUFFER_SECONDS * DEMUX_LOW_WATER_RATIO;
+        this->aborted               = false;
+        this->finished              = false;
+        this->error                 = 0;
+        this->sleeps                = 0;
+        this->underruns             = 0;
+        this->thread                = nullptr;
+        this->mutex                 = SDL_CreateMutex();
+        this->cond                  = SDL_CreateCond();
+
+        if (video_stream_index >= 0) video_queue->set_time_base(format_ctx->streams[video_stream_index]->time_base);
+        if (audio_stream_index >= 0) audio_queue->set_time_base(format_ctx->streams[audio_stream_index]->time_base);
+        video_queue->set_pop_cond(this->cond);
+        audio_queue->set_pop_cond(this->cond);
+    }
+
+    ~DEMUXER() {
+        stop();
+        this->video_queue->set_pop_cond(nullptr);
+        this->audio_queue->set_pop_cond(nullptr);
+
+        SDL_DestroyCond(this->cond);
+        SDL_DestroyMutex(this->mutex);
+    }
+
+    DEMUXER(const DEMUXER&) = delete;
+    DEMUXER &operator=(const DEMUXER&) = delete;
+
+    /**
+     * Start demux thread.
+     * @param buffer_seconds media time to buffer ahead of playback.
+     * @return 0 on success or negative error code on failure.
+     */
+    int start(double buffer_seconds) {
+        if (buffer_seconds > 0) {
+            this->target    = buffer_seconds;
+            this->low_water = buffer_seconds * DEMUX_LOW_WATER_RATIO;
+        }
+
+        this->thread = SDL_CreateThread(demux_thread, "demux", this);
+        if (this->thread == nullptr) {
+            std::cerr << "Can't create demux thread with error: " << SDL_GetError() << std::endl;
+            return CREATE_DEMUX_THREAD_ERROR;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Stop demux thread and wait for it, packets already queued stay in queues.
+     * @return 0 or negative error code demux thread stopped with.
+     */
+    int stop() {
+        SDL_LockMutex(this->mutex);
+        this->aborted = true;
+        SDL_CondSignal(this->cond);
+        SDL_UnlockMutex(this->mutex);
+
+        if (this->thread) SDL_WaitThread(this->thread, nullptr);
+        this->thread = nullptr;
+
+        return this->error;
+    }
+
+    /**
+     * Check if every packet of input has been queued (or demuxing stopped on error).
+     * @return true when demux thread is done.
+     */
+    bool is_finished() {
+        SDL_LockMutex(this->mutex);
+        bool finished = this->finished;
+        SDL_UnlockMutex(this->mutex);
+
+        return finished;
+    }
+
+    /**
+     * Print buffering target and how often it was reached or ran empty.
+     */
+    void report() const {
+        std::cout << "Demux: buffering " << this->target << " s (resume under " << this->low_water << " s), buffer full "
+                  << this->sleeps << " times, " << this->underruns << " reads with a starved queue." << std::endl;
+    }
+};
+
+#endif //TUTORIAL_03_DEMUXER_H
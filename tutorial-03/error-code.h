@@ -32,7 +32,12 @@ enum ERROR_CODE {
     OPEN_SDL_AUDIO_ERROR,
     ALLOC_SWR_CONTEXT_ERROR,
     INIT_SWR_CONTEXT_ERROR,
-    CONVERT_AUDIO_FRAME_ERROR
+    CONVERT_AUDIO_FRAME_ERROR,
+    CREATE_SCALER_THREAD_ERROR,
+    CREATE_DECODE_THREAD_ERROR,
+    CREATE_RENDER_BACKEND_ERROR,
+    CREATE_DEMUX_THREAD_ERROR,
+    READ_PACKET_ERROR
 };
 
 #endif //TUTORIAL_03_ERROR_CODE_H
@@ -0,0 +1,155 @@
+#ifndef TUTORIAL_03_FRAME_DROP_H
+#define TUTORIAL_03_FRAME_DROP_H
+
+#include "iostream"
+#include "algorithm"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+}
+
+/**
+ * Levels of degradation, each level include all the levels before it.
+ */
+enum DROP_LEVEL {
+    DROP_LEVEL_NONE = 0,        // Decode and present every frame
+    DROP_LEVEL_SKIP_RENDER,     // Late frames are decoded but not converted, uploaded or presented
+    DROP_LEVEL_SKIP_DEBLOCK,    // Decoder skips loop filter and idct on non-reference frames
+    DROP_LEVEL_SKIP_NONREF,     // Decoder does not decode non-reference frames at all
+    DROP_LEVEL_COUNT
+};
+
+// A frame is late when it is behind the sync clock more than this (seconds)
+const double FRAME_LATE_THRESHOLD = 0.04;
+
+// Number of consecutive late frames before we go to next drop level
+const int DROP_ESCALATE_FRAMES = 8;
+
+// Number of consecutive on-time frames before we go back to previous drop level
+const int DROP_RECOVER_FRAMES = 60;
+
+/**
+ * Decide which video frames will be presented when the machine can't keep up with the sync clock.
+ *
+ * @note When frames keep coming late we first skip rendering, then tell the decoder to skip loop filter / idct, then
+ *       tell it to skip non-reference frames. When frames come on time again we step back until full quality.
+ */
+struct FRAME_DROPPER {
+private:
+    AVCodecContext *codec_ctx;
+    int level;
+    int late_streak;
+    int on_time_streak;
+    long presented;
+    long nonref_packets;        // Packets sent to decoder while it skips non-reference frames
+    long nonref_frames;         // Frames received from decoder while it skips non-reference frames
+    long dropped[DROP_LEVEL_COUNT];
+    long escalations[DROP_LEVEL_COUNT];
+
+    /**
+     * Update decoder discard settings for current level.
+     */
+    void apply_level() {
+        this->codec_ctx->skip_loop_filter   = this->level >= DROP_LEVEL_SKIP_DEBLOCK ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+        this->codec_ctx->skip_idct          = this->level >= DROP_LEVEL_SKIP_DEBLOCK ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+        this->codec_ctx->skip_frame         = this->level >= DROP_LEVEL_SKIP_NONREF  ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    }
+
+public:
+    explicit FRAME_DROPPER(AVCodecContext *codec_ctx) {
+        this->codec_ctx         = codec_ctx;
+        this->level             = DROP_LEVEL_NONE;
+        this->late_streak       = 0;
+        this->on_time_streak    = 0;
+        this->presented         = 0;
+        this->nonref_packets    = 0;
+        this->nonref_frames     = 0;
+
+        for (int i = 0; i < DROP_LEVEL_COUNT; ++i) {
+            this->dropped[i]        = 0;
+            this->escalations[i]    = 0;
+        }
+    }
+
+    /**
+     * Get current drop level.
+     * @return one of DROP_LEVEL.
+     */
+    int get_level() const {
+        return this->level;
+    }
+
+    /**
+     * Count a video packet sent to decoder, packets which never come out as frame are the ones it skipped.
+     */
+    void packet_sent() {
+        if (this->level >= DROP_LEVEL_SKIP_NONREF) this->nonref_packets++;
+    }
+
+    /**
+     * Get number of frames decoder skipped without decoding them at "DROP_LEVEL_SKIP_NONREF".
+     * @note Guessed from packets sent and frames received at that level, frames buffered inside decoder when level
+     *       changes may shift it by a few.
+     */
+    long skipped_by_decoder() const {
+        return std::max(0L, this->nonref_packets - this->nonref_frames);
+    }
+
+    /**
+     * Update drop level with lateness of a decoded frame and decide it should be presented or not.
+     * @param delay time in seconds from sync clock to frame pts, negative when frame is late.
+     * @return true if frame should be presented, false if it should be dropped.
+     */
+    bool should_render(double delay) {
+        bool late = delay < -FRAME_LATE_THRESHOLD;
+        if (this->level >= DROP_LEVEL_SKIP_NONREF) this->nonref_frames++;
+
+        if (late) {
+            this->late_streak++;
+            this->on_time_streak = 0;
+
+            if (this->late_streak >= DROP_ESCALATE_FRAMES && this->level < DROP_LEVEL_COUNT - 1) {
+                this->level++;
+                this->escalations[this->level]++;
+                this->late_streak = 0;
+                apply_level();
+            }
+        }
+        else {
+            this->on_time_streak++;
+            this->late_streak = 0;
+
+            if (this->on_time_streak >= DROP_RECOVER_FRAMES && this->level > DROP_LEVEL_NONE) {
+                this->level--;
+                this->on_time_streak = 0;
+                apply_level();
+            }
+        }
+
+        if (late && this->level >= DROP_LEVEL_SKIP_RENDER) {
+            this->dropped[this->level]++;
+            return false;
+        }
+
+        this->presented++;
+        return true;
+    }
+
+    /**
+     * Print number of frames presented and dropped at each level.
+     */
+    void report() const {
+        static const char *LEVEL_NAMES[DROP_LEVEL_COUNT] = {"none", "skip render", "skip deblock/idct", "skip non-ref"};
+
+        std::cout << "Frames presented: " << this->presented << std::endl;
+        for (int i = DROP_LEVEL_SKIP_RENDER; i < DROP_LEVEL_COUNT; ++i) {
+            long skipped = i == DROP_LEVEL_SKIP_NONREF ? skipped_by_decoder() : 0;
+            std::cout << "Drop level " << i << " (" << LEVEL_NAMES[i] << "): " << this->dropped[i] + skipped
+                      << " frames dropped";
+            if (i == DROP_LEVEL_SKIP_NONREF) std::cout << " (" << skipped << " skipped by decoder)";
+            std::cout << ", entered " << this->escalations[i] << " times" << std::endl;
+        }
+    }
+};
+
+#endif //TUTORIAL_03_FRAME_DROP_H
@@ -0,0 +1,97 @@
+#ifndef TUTORIAL_03_FRAME_PACER_H
+#define TUTORIAL_03_FRAME_PACER_H
+
+#include "iostream"
+#include "cmath"
+#include "algorithm"
+#include "SDL.h"
+#include "sync-clock.h"
+
+// Last part of the wait is done by spinning because SDL_Delay can oversleep about a millisecond (seconds)
+const double PACER_SPIN_TIME = 0.002;
+
+// Longest sleep of a single wait, so render loop keep handling events while a frame is far ahead (milliseconds)
+const Uint32 PACER_SLEEP_STEP_MS = 10;
+
+// Frames further ahead of sync clock than this (timestamp discontinuity or bad pts) move the clock instead (seconds)
+const double PACER_MAX_WAIT = 1.0;
+
+// Upper bound in milliseconds of each jitter histogram bucket, last bucket hold everything bigger
+const double PACER_BUCKET_LIMITS[] = {0.25, 0.5, 1.0, 2.0, 4.0, 8.0, 16.0, 33.0};
+const int PACER_BUCKETS = sizeof(PACER_BUCKET_LIMITS) / sizeof(PACER_BUCKET_LIMITS[0]) + 1;
+
+/**
+ * Wait until scheduled time of a frame and measure how far from that time frames really got presented.
+ */
+struct FRAME_PACER {
+private:
+    long histogram[PACER_BUCKETS];
+    long count;
+    double total_jitter;
+    double max_jitter;
+
+public:
+    FRAME_PACER() {
+        for (long &bucket : this->histogram) bucket = 0;
+        this->count         = 0;
+        this->total_jitter  = 0.0;
+        this->max_jitter    = 0.0;
+    }
+
+    /**
+     * Wait for sync clock to reach given pts, sleep for most of the time then spin for the rest.
+     * @param clock sync clock.
+     * @param pts time frame should be presented in seconds.
+     * @return true when pts is reached, false after sleeping "PACER_SLEEP_STEP_MS" without reaching it, caller should
+     *         then handle its events and call again.
+     * @note Caller must keep pts within "PACER_MAX_WAIT" of the clock, a frame too far ahead should re-anchor it.
+     */
+    static bool wait_until(const SYNC_CLOCK &clock, double pts) {
+        double remaining = pts - clock.get();
+
+        if (remaining > PACER_SPIN_TIME) {
+            SDL_Delay((Uint32)std::min((remaining - PACER_SPIN_TIME) * 1000.0, (double)PACER_SLEEP_STEP_MS));
+            if (pts - clock.get() > PACER_SPIN_TIME) return false;
+        }
+
+        while (clock.get() < pts) {
+            // Spin
+        }
+        return true;
+    }
+
+    /**
+     * Record difference between time frame got presented and time it was scheduled.
+     * @param jitter difference in seconds.
+     */
+    void record(double jitter) {
+        double jitter_ms = fabs(jitter) * 1000.0;
+        int bucket = 0;
+
+        while (bucket < PACER_BUCKETS - 1 && jitter_ms > PACER_BUCKET_LIMITS[bucket]) bucket++;
+
+        this->histogram[bucket]++;
+        this->count++;
+        this->total_jitter += jitter_ms;
+        if (jitter_ms > this->max_jitter) this->max_jitter = jitter_ms;
+    }
+
+    /**
+     * Print jitter histogram.
+     */
+    void report() const {
+        if (this->count == 0) return;
+
+        std::cout << "Pacing jitter (" << this->count << " frames, mean " << this->total_jitter / this->count
+                  << " ms, max " << this->max_jitter << " ms):" << std::endl;
+
+        for (int i = 0; i < PACER_BUCKETS; ++i) {
+            if (i < PACER_BUCKETS - 1) std::cout << "  <= " << PACER_BUCKET_LIMITS[i] << " ms: ";
+            else std::cout << "  >  " << PACER_BUCKET_LIMITS[i - 1] << " ms: ";
+
+            std::cout << this->histogram[i] << std::endl;
+        }
+    }
+};
+
+#endif //TUTORIAL_03_FRAME_PACER_H
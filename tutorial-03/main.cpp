@@ -2,6 +2,21 @@
 #include "SDL.h"
 #include "SDL_thread.h"
 #include "error-code.h"
+#include "sync-clock.h"
+#include "frame-drop.h"
+#include "sliced-scaler.h"
+#include "picture-queue.h"
+#include "frame-pacer.h"
+#include "render-backend.h"
+#include "stage-timer.h"
+#include "mmap-input.h"
+#include "read-ahead-input.h"
+#include "memory-input.h"
+#include "pipe-input.h"
+#include "stream-info-cache.h"
+#include "stream-select.h"
+#include "packet-queue.h"
+#include "demuxer.h"
 
 extern "C" {
 #include "libavformat/avformat.h"
@@ -14,165 +29,37 @@ extern "C" {
 using namespace std;
 
 /**
- * Queue implement for store AVPacket.
+ * Everything decode thread need to decode and convert video frames.
  */
-struct PACKET_QUEUE {
-private:
-    AVPacketList *first_packet;
-    AVPacketList *last_packet;
-    SDL_mutex *mutex;
-    SDL_cond *cond;
-    int _size;
-    int _length;
-
-public:
-    PACKET_QUEUE() {
-        this->first_packet      = nullptr;
-        this->last_packet       = nullptr;
-        this->mutex             = SDL_CreateMutex();
-        this->cond              = SDL_CreateCond();
-        this->_size              = 0;
-        this->_length            = 0;
-    }
-
-    /**
-     * Get size in bytes of all packets stored.
-     * @return size in bytes.
-     */
-    int size() const {
-        return this->_size;
-    }
-
-    /**
-     * Get number of packet stored in this queue.
-     * @return number of packet.
-     */
-    int length() const {
-        return this->_length;
-    }
-
-    /**
-     * Push new AVPacket in queue.
-     * @note Do not apply "av_packet_unref" or "av_packet_free" with packet passed into this function.
-     * @param packet packet want to store.
-     */
-    void push(AVPacket *packet) {
-        SDL_LockMutex(this->mutex);
-
-        auto *next_packet   = (AVPacketList*)(malloc(sizeof(AVPacketList)));
-        next_packet->pkt    = *packet;
-        next_packet->next   = nullptr;
-
-        if (!this->first_packet) {
-            this->first_packet  = next_packet;
-            this->last_packet   = next_packet;
-        }
-        else {
-            this->last_packet->next = next_packet;
-            this->last_packet = this->last_packet->next;
-        }
-
-        this->_size += packet->size;
-        this->_length += 1;
-
-        SDL_UnlockMutex(this->mutex);
-        SDL_CondSignal(this->cond);
-    }
-
-    /**
-     * Retrieves a packet that has been pushed to the queue.
-     * @note AVPacket receive from this function need to be free with "av_packet_free" when they are no longer needed.
-     * @param wait if "wait" is true thread will be blocked if no packet in queue until a new packet pushed.
-     * @return "AVPacket" pointer or "nullptr" when no packet in queue ("nullptr" will just return when "wait" is false).
-     */
-    AVPacket *get(bool wait) {
-        SDL_LockMutex(this->mutex);
-        AVPacket *transit_packet = nullptr;
-
-        for(;;) {
-            if (this->first_packet) {
-                /* Update size and length of this queue */
-                this->_size -= this->first_packet->pkt.size;
-                this->_length -= 1;
-
-                // Alloc memory for a transit packet
-                transit_packet = av_packet_alloc();
-
-
-                // Copy data from packet stored in first_packet to transit_packet
-                *transit_packet = this->first_packet->pkt;
-
-                /* Move first_packet to next packet list and free old data */
-                AVPacketList *transit_packet_list = this->first_packet;
-                this->first_packet = this->first_packet->next;
-                free(transit_packet_list);
-
-                break;
-            }
-            else if (wait) {
-                // Unlock mute and freeze this thread until we reached SDL_CondSignal and thread will continue from here
-                SDL_CondWait(this->cond, this->mutex);
-            }
-            else {
-                SDL_UnlockMutex(this->mutex);
-                return nullptr;
-            }
-        }
-
-        SDL_UnlockMutex(this->mutex);
-        return transit_packet;
-    }
+struct DECODE_CONTEXT {
+    PACKET_QUEUE        *video_packet_queue;
+    AVCodecContext      *video_codec_ctx;
+    AVStream            *video_stream;
+    AVFrame             *frame;
+    SLICED_SCALER       *scaler;
+    FRAME_DROPPER       *frame_dropper;
+    PICTURE_QUEUE       *picture_queue;
+    STAGE_TIMER         *stage_timer;
+    int                 display_width;
+    int                 display_height;
+    double              frame_duration;     // Seconds between frames, used to guess pts of frames having none
+    bool                realtime;
 };
 
 const int AUDIO_BUFFER_SIZE = 1024;
 const int MAX_AUDIO_FRAME_SIZE = 192000;
 
+// Max time render loop wait for a picture before it go back to handle SDL events
+const Uint32 RENDER_POLL_MS = 10;
+
+// Size of the empty window shown while playing input without video, closing it stop playback
+const int AUDIO_ONLY_WINDOW_WIDTH = 320;
+const int AUDIO_ONLY_WINDOW_HEIGHT = 180;
+
 bool            quit                    = false;
 PACKET_QUEUE    *audio_packet_queue     = new PACKET_QUEUE;
-SDL_Window      *window                 = nullptr;
-SDL_Renderer    *renderer               = nullptr;
-SDL_Texture     *texture                = nullptr;
+SYNC_CLOCK      sync_clock;
 SDL_AudioSpec   audio_spec;
-SDL_Rect        display_rect;
-SDL_Event       event;
-
-/**
- * Init SDL library for render video frame on screen
- * @param SCREEN_WIDTH width of window want to create
- * @param SCREEN_HEIGHT height of window want to create
- * @return 0 on success or negative error code on failure
- */
-int init_sdl(const int SCREEN_WIDTH, const int SCREEN_HEIGHT) {
-    if ((SDL_Init(SDL_INIT_VIDEO)) < 0) {
-        cerr << "Can't init SDL library with error: " << SDL_GetError() << endl;
-        return INIT_SDL_LIB_ERROR;
-    }
-
-    window = SDL_CreateWindow("FFmpeg tutorial", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
-    if (window == nullptr) {
-        cerr << "Can't create SDL window with error: " << SDL_GetError() << endl;
-        return CREATE_SDL_WINDOW_ERROR;
-    }
-
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
-    if (renderer == nullptr) {
-        cerr << "Can't create SDL renderer with error: " << SDL_GetError() << endl;
-        return CREATE_SDL_RENDERER_ERROR;
-    }
-
-    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_IYUV, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
-    if (texture == nullptr) {
-        cerr << "Can't create SDL texture with error: " << SDL_GetError() << endl;
-        return CREATE_SDL_TEXTURE_ERROR;
-    }
-
-    display_rect.x = 0;
-    display_rect.y = 0;
-    display_rect.w = SCREEN_WIDTH;
-    display_rect.h = SCREEN_HEIGHT;
-
-    return 0;
-}
 
 int audio_resampling(AVCodecContext *audio_codec_ctx, uint8_t AUDIO_BUFFER[], AVFrame *audio_frame) {
     int         ret                     = 0;
@@ -220,6 +107,12 @@ int audio_decode(AVCodecContext *audio_codec_ctx, uint8_t AUDIO_BUFFER[]) {
     AVFrame     *audio_frame    = av_frame_alloc();
     int         buffer_len      = 0;
 
+    // Queue is finished and empty or playback is stopped
+    if (audio_packet == nullptr) {
+        av_frame_free(&audio_frame);
+        return AVERROR_EOF;
+    }
+
     if (audio_frame == nullptr) {
         cerr << "Can't alloc memory for audio frame." << endl;
         av_frame_free(&audio_frame);
@@ -286,8 +179,9 @@ void audio_callback(void *userdata, Uint8 *stream, int len) {
 
             int ret = audio_decode(audio_codec_ctx, AUDIO_BUFFER);
 
-            if (last < 0) {
-                fill(stream, stream + len, 0);
+            // Error or end of audio, play silence for what is left
+            if (ret < 0) {
+                fill(stream + stream_first, stream + stream_first + len, 0);
                 break;
             }
 
@@ -311,10 +205,187 @@ void audio_callback(void *userdata, Uint8 *stream, int len) {
     }
 }
 
+/**
+ * Get size of display target, frame is fit into it with same aspect ratio and never scaled up.
+ * @param query_display use usable bounds of the first display when no max size is given.
+ * @param max_width max width from command line, 0 when not given.
+ * @param max_height max height from command line, 0 when not given.
+ * @param src_width width of decoded frame.
+ * @param src_height height of decoded frame.
+ * @param width output width of display target.
+ * @param height output height of display target.
+ * @return 0 on success or negative error code on failure
+ */
+int get_display_size(bool query_display, int max_width, int max_height, int src_width, int src_height, int *width, int *height) {
+    SDL_Rect bounds = {0, 0, src_width, src_height};
+
+    if (max_width > 0 && max_height > 0) {
+        bounds.w = max_width;
+        bounds.h = max_height;
+    }
+    else if (query_display) {
+        if ((SDL_Init(SDL_INIT_VIDEO)) < 0) {
+            cerr << "Can't init SDL library with error: " << SDL_GetError() << endl;
+            return INIT_SDL_LIB_ERROR;
+        }
+
+        if (SDL_GetDisplayUsableBounds(0, &bounds) < 0) {
+            cerr << "Can't get display bounds, use frame size: " << SDL_GetError() << endl;
+            bounds.w = src_width;
+            bounds.h = src_height;
+        }
+    }
+
+    double ratio = min(1.0, min((double)bounds.w / src_width, (double)bounds.h / src_height));
+
+    // YUV420 need even width and height
+    *width  = max(2, (int)(src_width * ratio) & ~1);
+    *height = max(2, (int)(src_height * ratio) & ~1);
+
+    return 0;
+}
+
+/**
+ * Choose biggest lowres factor of decoder which still produce frame not smaller than display target.
+ * @param codec video decoder.
+ * @param src_width width of coded frame.
+ * @param src_height height of coded frame.
+ * @param width width of display target.
+ * @param height height of display target.
+ * @return lowres factor, 0 when decoder does not support lowres decoding.
+ */
+int choose_lowres(const AVCodec *codec, int src_width, int src_height, int width, int height) {
+    int lowres = 0;
+
+    while (lowres < codec->max_lowres
+           && (src_width >> (lowres + 1)) >= width
+           && (src_height >> (lowres + 1)) >= height) {
+        lowres++;
+    }
+
+    return lowres;
+}
+
+/**
+ * Decode video packets from video packet queue and convert frames into picture queue.
+ * @param userdata pointer to DECODE_CONTEXT.
+ * @return 0 on success or negative error code on failure.
+ */
+int decode_thread(void *userdata) {
+    auto    *ctx        = (DECODE_CONTEXT*)userdata;
+    int     ret         = 0;
+    bool    eof         = false;
+    double  next_pts    = 0.0;      // Pts expected for next frame, given to frames without timestamp
+
+    // Packets come from demux thread, "nullptr" once input is finished or playback stopped
+    while (!eof && !quit && ctx->video_codec_ctx != nullptr) {
+        AVPacket *packet = ctx->video_packet_queue->get(true);
+        eof = packet == nullptr;
+
+        // At end of input a null packet drain frames still inside decoder
+        Uint64 stage_begin = STAGE_TIMER::now();
+        ret = avcodec_send_packet(ctx->video_codec_ctx, packet);
+        ctx->stage_timer->add(STAGE_DECODE, stage_begin);
+        if (packet != nullptr && ret >= 0) ctx->frame_dropper->packet_sent();
+        av_packet_free(&packet);
+
+        if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+            cerr << "Error when sending video packet." << endl;
+            ctx->picture_queue->finish();
+            return SEND_VIDEO_PACKET_ERROR;
+        }
+
+        while (ret >= 0) {
+            stage_begin = STAGE_TIMER::now();
+            ret = avcodec_receive_frame(ctx->video_codec_ctx, ctx->frame);
+            ctx->stage_timer->add(STAGE_DECODE, stage_begin);
+
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+            else if (ret < 0) {
+                cerr << "Error when receive video frame." << endl;
+                ctx->picture_queue->finish();
+                return RECEIVE_VIDEO_FRAME_ERROR;
+            }
+
+            // Frames without timestamp follow previous frame by one frame duration
+            int64_t timestamp = ctx->frame->best_effort_timestamp;
+            if (timestamp == AV_NOPTS_VALUE) timestamp = ctx->frame->pts;
+
+            double pts = timestamp != AV_NOPTS_VALUE ? (double)timestamp * av_q2d(ctx->video_stream->time_base) : next_pts;
+            next_pts = pts + ctx->frame_duration;
+
+            /* Frames already behind sync clock when decoded are handled by frame dropper, nothing is dropped without display */
+            if (!sync_clock.is_started()) sync_clock.start(pts);
+
+            if (ctx->realtime && !ctx->frame_dropper->should_render(pts - sync_clock.get())) {
+                av_frame_unref(ctx->frame);
+                continue;
+            }
+
+            // Wait for a free picture, render thread present and release them at frame rate
+            VIDEO_PICTURE *picture = ctx->picture_queue->peek_writable();
+            if (picture == nullptr) {
+                av_frame_unref(ctx->frame);
+                break;
+            }
+
+            stage_begin = STAGE_TIMER::now();
+            if (ctx->video_codec_ctx->pix_fmt != AV_PIX_FMT_YUV420P
+                || ctx->video_codec_ctx->width != ctx->display_width || ctx->video_codec_ctx->height != ctx->display_height) {
+                ctx->scaler->scale(ctx->frame->data, ctx->frame->linesize, picture->data, picture->linesize);
+            }
+            else {
+                av_image_copy(picture->data, picture->linesize, (const uint8_t**)ctx->frame->data, ctx->frame->linesize,
+                              AV_PIX_FMT_YUV420P, ctx->display_width, ctx->display_height);
+            }
+            ctx->stage_timer->add(STAGE_CONVERT, stage_begin);
+
+            picture->pts = pts;
+            picture->pos = ctx->frame->pkt_pos;
+            ctx->picture_queue->push();
+
+            av_frame_unref(ctx->frame);
+        }
+    }
+
+    ctx->picture_queue->finish();
+    return 0;
+}
+
+/**
+ * Print time from launch to first presented frame.
+ * @param launched performance counter at start of main.
+ * @param stream_info_time performance counter ticks spent finding stream info.
+ * @param stream_info_cached true when stream info came from cache instead of probing.
+ */
+void print_time_to_first_frame(Uint64 launched, Uint64 stream_info_time, bool stream_info_cached) {
+    double frequency = (double)SDL_GetPerformanceFrequency();
+
+    cout << "Time to first frame: " << (double)(SDL_GetPerformanceCounter() - launched) / frequency * 1000.0
+         << " ms (stream info " << (stream_info_cached ? "from cache" : "probed") << " in "
+         << (double)stream_info_time / frequency * 1000.0 << " ms)." << endl;
+}
+
 int main(int argc, char *args[]) {
+    Uint64                  launched                    = STAGE_TIMER::now();
     int                     ret                         = 0;
     AVFormatContext         *format_ctx                 = nullptr;
     string                  file_path                   = "../../videos/video.flv";
+    MMAP_INPUT              mmap_input;
+    READ_AHEAD_INPUT        read_ahead_input;
+    MEMORY_INPUT            memory_input;
+    PIPE_INPUT              pipe_input;
+    bool                    use_pipe                    = false;
+    Uint64                  opened                      = 0;
+    bool                    load_in_memory              = false;
+    string                  shm_name;
+    PROBE_SETTINGS          probe_settings              = {0, 0};
+    STREAM_INFO_CACHE       stream_info_cache;
+    bool                    stream_info_cached          = false;
+    Uint64                  stream_info_time            = 0;
+    int                     read_ahead_mb               = 0;
+    bool                    use_read_ahead              = false;
+    STREAM_SELECT           stream_select               = STREAM_SELECT_BOTH;
     int                     video_stream_index          = -1;
     int                     audio_stream_index          = -1;
     AVStream                *video_stream               = nullptr;
@@ -325,12 +396,49 @@ int main(int argc, char *args[]) {
     const AVCodec           *audio_codec                = nullptr;
     AVCodecContext          *video_codec_ctx            = nullptr;
     AVCodecContext          *audio_codec_ctx            = nullptr;
-    AVPacket                *packet                     = nullptr;
     AVFrame                 *frame                      = nullptr;
-    SwsContext              *sws_ctx                    = nullptr;
+    SLICED_SCALER           scaler;
     SwrContext              *swr_ctx                    = nullptr;
-    uint8_t                 *yuv420_frame[4]            = {nullptr};
-    int                     yuv420_frame_linesize[4]    = {0};
+    bool                    use_vsync                   = false;
+    const char              *backend_name               = "window";
+    RENDER_BACKEND          *backend                    = nullptr;
+    int                     max_width                   = 0;
+    int                     max_height                  = 0;
+    int                     display_width               = 0;
+    int                     display_height              = 0;
+    double                  buffer_seconds              = 0;
+
+    /*
+     * Command line: [max_width max_height] [--vsync] [--backend=window|offscreen|null] [--read-ahead=MB] [--memory]
+     * [--shm=NAME] [--video-only|--audio-only] [--buffer=SECONDS]
+     * [--input=PATH]
+     * Render loop pace frames itself, "--vsync" also make SDL_RenderPresent wait for vertical blank. Offscreen and null
+     * backends need no display and run the pipeline as fast as possible. "--read-ahead" read input on an I/O thread
+     * with a window of MB instead of mapping it. "--memory" load whole input in memory before playing and "--shm" play
+     * media from shared-memory segment NAME, input path then only hint the container format. "--probesize=BYTES" and
+     * "--analyzeduration=US" limit probing of stream info, "--stream-info-cache" keep probed stream info in
+     * "<input>.sinfo" so next runs skip probing. Time to first frame is printed once it is presented. "--video-only" and
+     * "--audio-only" play one stream, input with only video or only audio is played without the other anyway.
+     * Packets are read on a demux thread ahead of playback, "--buffer" set how many seconds of media it keep queued.
+     * "--input" play PATH instead of sample video, "-" (or "pipe:") read standard input. Standard input and named pipes
+     * are read forward only with low-delay demuxing, startup and arrival to present latency are then reported.
+     */
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(args[i], "--vsync") == 0) use_vsync = true;
+        else if (strncmp(args[i], "--backend=", 10) == 0) backend_name = args[i] + 10;
+        else if (strncmp(args[i], "--read-ahead=", 13) == 0) read_ahead_mb = atoi(args[i] + 13);
+        else if (strcmp(args[i], "--memory") == 0) load_in_memory = true;
+        else if (strncmp(args[i], "--shm=", 6) == 0) shm_name = args[i] + 6;
+        else if (strncmp(args[i], "--probesize=", 12) == 0) probe_settings.probesize = atoll(args[i] + 12);
+        else if (strncmp(args[i], "--analyzeduration=", 18) == 0) probe_settings.analyze_duration = atoll(args[i] + 18);
+        else if (strcmp(args[i], "--stream-info-cache") == 0) stream_info_cache.enable();
+        else if (strcmp(args[i], "--video-only") == 0) stream_select = STREAM_SELECT_VIDEO_ONLY;
+        else if (strcmp(args[i], "--audio-only") == 0) stream_select = STREAM_SELECT_AUDIO_ONLY;
+        else if (strncmp(args[i], "--buffer=", 9) == 0) buffer_seconds = atof(args[i] + 9);
+        else if (strncmp(args[i], "--input=", 8) == 0) file_path = args[i] + 8;
+        else if (max_width == 0) max_width = atoi(args[i]);
+        else max_height = atoi(args[i]);
+    }
 
     // Alloc format context for store data inside input file
     if ((format_ctx = avformat_alloc_context()) == nullptr) {
@@ -338,245 +446,294 @@ int main(int argc, char *args[]) {
         return ALLOC_FMT_CTX_ERROR;
     }
 
+    // "--shm" and "--memory" serve input from memory so nothing is read from disk while demuxing. Otherwise local files
+    // are served from a memory mapping, with "--read-ahead" or when input can't be mapped (URL) an I/O thread read ahead
+    // of the demuxer instead. Pipes can't be mapped nor seeked, they are read forward as data arrive
+    if (!shm_name.empty()) {
+        if (!memory_input.attach_shared_memory(shm_name, format_ctx)) {
+            cerr << "Can't map shared memory: " << shm_name << endl;
+            return OPEN_INPUT_ERROR;
+        }
+
+        // Input path only hint the format, cache entry of that path would describe other media
+        stream_info_cache.disable();
+    }
+    else if (PIPE_INPUT::is_pipe(file_path)) {
+        if (!(use_pipe = pipe_input.attach(file_path, format_ctx))) {
+            cerr << "Can't open pipe: " << file_path << endl;
+            return OPEN_INPUT_ERROR;
+        }
+    }
+    else if (load_in_memory) {
+        uint64_t started = SDL_GetPerformanceCounter();
+        if (!memory_input.load_file(file_path, format_ctx)) {
+            cerr << "Can't load input file in memory." << endl;
+            return OPEN_INPUT_ERROR;
+        }
+        cout << "Loaded " << memory_input.input_size() / 1024 << " KB in memory in "
+             << (double)(SDL_GetPerformanceCounter() - started) * 1000 / SDL_GetPerformanceFrequency() << " ms." << endl;
+    }
+    else if (read_ahead_mb > 0 || !mmap_input.attach(file_path, format_ctx)) {
+        size_t window = (size_t)(read_ahead_mb > 0 ? read_ahead_mb : READ_AHEAD_DEFAULT_WINDOW_MB) * 1024 * 1024;
+        use_read_ahead = read_ahead_input.attach(file_path, format_ctx, window);
+    }
+
+    apply_probe_settings(format_ctx, probe_settings);
+
     // Open input file and store data in format_ctx
     if ((avformat_open_input(&format_ctx, file_path.data(), nullptr, nullptr)) < 0) {
         cerr << "Can't open input file with given path." << endl;
         return OPEN_INPUT_ERROR;
     }
 
-    // Find stream info in input file
-    if ((avformat_find_stream_info(format_ctx, nullptr)) < 0) {
-        cerr << "Can't find stream info." << endl;
-        return FIND_STREAM_INFO_ERROR;
-    }
+    // Find stream info in input file, from cache when "--stream-info-cache" already probed it
+    stream_info_time = STAGE_TIMER::now();
+    if ((ret = stream_info_cache.find_stream_info(format_ctx, file_path, &stream_info_cached)) < 0) return ret;
+    stream_info_time = STAGE_TIMER::now() - stream_info_time;
+    opened = STAGE_TIMER::now();
 
-    // Find audio and video stream
-    for (int i = 0; i < format_ctx->nb_streams; ++i) {
-        if (format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-            video_stream_index  = i;
-            video_stream        = format_ctx->streams[i];
-            video_codec_params  = format_ctx->streams[i]->codecpar;
-        }
-        if (format_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-            audio_stream_index  = i;
-            audio_stream        = format_ctx->streams[i];
-            audio_codec_params  = format_ctx->streams[i]->codecpar;
-        }
+    if ((backend = create_render_backend(backend_name, use_vsync)) == nullptr) {
+        cerr << "Unknown render backend: " << backend_name << endl;
+        return CREATE_RENDER_BACKEND_ERROR;
     }
 
-    /* Check for sure we found video and audio stream */
-    if (video_stream_index < 0) {
-        cerr << "Can't find video stream." << endl;
-        return VIDEO_STREAM_NOT_FOUND;
-    }
+    // Audio is only played with a display, other backends do not even demux it
+    if (!backend->is_realtime() && stream_select == STREAM_SELECT_BOTH) stream_select = STREAM_SELECT_VIDEO_ONLY;
 
-    if (audio_stream_index < 0) {
-        cerr << "Can't find audio stream." << endl;
-        return AUDIO_STREAM_NOT_FOUND;
-    }
+    // Find audio and video stream, demuxer discard every other stream and the one not selected on command line
+    if ((ret = select_streams(format_ctx, stream_select, &video_stream_index, &audio_stream_index)) < 0) return ret;
 
-    /* Find video and audio decoder */
-    video_codec = avcodec_find_decoder(video_codec_params->codec_id);
-    if (video_codec == nullptr) {
-        cerr << "Can't find decoder for video with codec: " << avcodec_get_name(video_codec_params->codec_id) << endl;
-        return FIND_VIDEO_DECODER_ERROR;
+    if (video_stream_index >= 0) {
+        video_stream        = format_ctx->streams[video_stream_index];
+        video_codec_params  = video_stream->codecpar;
     }
-
-    audio_codec = avcodec_find_decoder(audio_codec_params->codec_id);
-    if (audio_codec == nullptr) {
-        cerr << "Can't find decoder for audio with codec: " << avcodec_get_name(audio_codec_params->codec_id) << endl;
-        return FIND_AUDIO_DECODER_ERROR;
+    if (audio_stream_index >= 0) {
+        audio_stream        = format_ctx->streams[audio_stream_index];
+        audio_codec_params  = audio_stream->codecpar;
     }
+    if (video_stream_index < 0) cout << "Playing audio only." << endl;
+    else if (audio_stream_index < 0) cout << "Playing video only." << endl;
 
-    /* Set update video and audio codec context */
-    if ((video_codec_ctx = avcodec_alloc_context3(video_codec)) == nullptr) {
-        cerr << "Can't alloc video codec context." << endl;
-        return ALLOC_VIDEO_CODEC_CTX_ERROR;
-    }
+    /* Open video decoder, frames are decoded in lowres when the codec supports it and then scaled to display size */
+    if (video_stream_index >= 0) {
+        video_codec = avcodec_find_decoder(video_codec_params->codec_id);
+        if (video_codec == nullptr) {
+            cerr << "Can't find decoder for video with codec: " << avcodec_get_name(video_codec_params->codec_id) << endl;
+            return FIND_VIDEO_DECODER_ERROR;
+        }
 
-    if ((audio_codec_ctx = avcodec_alloc_context3(audio_codec)) == nullptr) {
-        cerr << "Can't alloc audio codec context." << endl;
-        return ALLOC_AUDIO_CODEC_CTX_ERROR;
-    }
+        if ((video_codec_ctx = avcodec_alloc_context3(video_codec)) == nullptr) {
+            cerr << "Can't alloc video codec context." << endl;
+            return ALLOC_VIDEO_CODEC_CTX_ERROR;
+        }
 
-    /* Copy video and audio codec params to context */
-    if ((avcodec_parameters_to_context(video_codec_ctx, video_codec_params)) < 0) {
-        cerr << "Can't copy video codec params to video codec context." << endl;
-        return COPY_VIDEO_CODEC_PARAMS_ERROR;
-    }
+        if ((avcodec_parameters_to_context(video_codec_ctx, video_codec_params)) < 0) {
+            cerr << "Can't copy video codec params to video codec context." << endl;
+            return COPY_VIDEO_CODEC_PARAMS_ERROR;
+        }
 
-    if ((avcodec_parameters_to_context(audio_codec_ctx, audio_codec_params)) < 0) {
-        cerr << "Can't copy audio codec params to audio codec context." << endl;
-        return COPY_AUDIO_CODEC_PARAMS_ERROR;
-    }
+        if ((ret = get_display_size(backend->is_realtime(), max_width, max_height, video_codec_params->width, video_codec_params->height, &display_width, &display_height)) < 0) {
+            return ret;
+        }
 
-    /* Now we need open video and audio codec for ready to read and decode video and audio packet */
-    if (avcodec_open2(video_codec_ctx, video_codec, nullptr) < 0) {
-        cerr << "Can't open video codec context." << endl;
-        return OPEN_VIDEO_CODEC_ERROR;
-    }
+        video_codec_ctx->lowres = choose_lowres(video_codec, video_codec_params->width, video_codec_params->height,
+                                                display_width, display_height);
 
-    if (avcodec_open2(audio_codec_ctx, audio_codec, nullptr) < 0) {
-        cerr << "Can't open audio codec context." << endl;
-        return OPEN_AUDIO_CODEC_ERROR;
+        if (avcodec_open2(video_codec_ctx, video_codec, nullptr) < 0) {
+            cerr << "Can't open video codec context." << endl;
+            return OPEN_VIDEO_CODEC_ERROR;
+        }
+    }
+    else {
+        display_width   = AUDIO_ONLY_WINDOW_WIDTH;
+        display_height  = AUDIO_ONLY_WINDOW_HEIGHT;
     }
 
-    /* Alloc packet for read packet from input file and frame for receive frame decoded from packet */
-    if ((packet = av_packet_alloc()) == nullptr) {
-        cerr << "Can't alloc packet." << endl;
-        return ALLOC_PACKET_ERROR;
+    /* Open audio decoder */
+    if (audio_stream_index >= 0) {
+        audio_codec = avcodec_find_decoder(audio_codec_params->codec_id);
+        if (audio_codec == nullptr) {
+            cerr << "Can't find decoder for audio with codec: " << avcodec_get_name(audio_codec_params->codec_id) << endl;
+            return FIND_AUDIO_DECODER_ERROR;
+        }
+
+        if ((audio_codec_ctx = avcodec_alloc_context3(audio_codec)) == nullptr) {
+            cerr << "Can't alloc audio codec context." << endl;
+            return ALLOC_AUDIO_CODEC_CTX_ERROR;
+        }
+
+        if ((avcodec_parameters_to_context(audio_codec_ctx, audio_codec_params)) < 0) {
+            cerr << "Can't copy audio codec params to audio codec context." << endl;
+            return COPY_AUDIO_CODEC_PARAMS_ERROR;
+        }
+
+        if (avcodec_open2(audio_codec_ctx, audio_codec, nullptr) < 0) {
+            cerr << "Can't open audio codec context." << endl;
+            return OPEN_AUDIO_CODEC_ERROR;
+        }
     }
 
+    // Alloc frame for receive frame decoded from packet
     if ((frame = av_frame_alloc()) == nullptr) {
         cerr << "Can't alloc frame." << endl;
         return ALLOC_FRAME_ERROR;
     }
 
-    /* Get SwsContext for scaling and converting frame data */
-    sws_ctx = sws_getContext(video_codec_ctx->width, video_codec_ctx->height, video_codec_ctx->pix_fmt,
-                             video_codec_ctx->width, video_codec_ctx->height, AV_PIX_FMT_YUV420P,
-                             SWS_BILINEAR, nullptr, nullptr, nullptr);
-    if (sws_ctx == nullptr) {
-        cerr << "Can't get sws context." << endl;
-        return GET_SWS_CTX_ERROR;
+    /* Get SwsContext for scaling and converting frame data, big frames are converted in parallel slices */
+    if (video_stream_index >= 0) {
+        int scaler_slices = SLICED_SCALER::choose_slice_count(video_codec_ctx->width, video_codec_ctx->height, display_height,
+                                                              av_q2d(av_guess_frame_rate(format_ctx, video_stream, nullptr)));
+        ret = scaler.init(video_codec_ctx->width, video_codec_ctx->height, video_codec_ctx->pix_fmt,
+                          display_width, display_height, AV_PIX_FMT_YUV420P, scaler_slices);
+        if (ret < 0) {
+            return ret;
+        }
+        cout << "Converting frames in " << scaler.slices() << " slice(s)." << endl;
+        cout << "Decoding " << video_codec_ctx->width << "x" << video_codec_ctx->height << " (lowres " << video_codec_ctx->lowres
+             << "), displaying " << display_width << "x" << display_height << ", uploading "
+             << av_image_get_buffer_size(AV_PIX_FMT_YUV420P, display_width, display_height, 1) << " bytes per frame." << endl;
     }
 
-    /* Alloc memory for store yuv420 data */
-    ret = av_image_alloc(yuv420_frame, yuv420_frame_linesize, video_codec_ctx->width, video_codec_ctx->height, AV_PIX_FMT_YUV420P, 1);
-    if (ret < 0) {
-        cerr << "Can't alloc memory for RGB frame" << endl;
-        return ALLOC_RGB_FRAME_ERROR;
+    // Init render backend for output frame
+    if ((ret = backend->init(display_width, display_height)) < 0) {
+        return ret;
     }
+    cout << "Rendering with " << backend->name() << " backend." << endl;
+
+    /* Setup SDL audio, audio is not played when running without display */
+    if (audio_codec_ctx != nullptr && backend->is_realtime()) {
+        audio_spec.freq = audio_codec_ctx->sample_rate;
+        audio_spec.format = AUDIO_S16SYS;
+        audio_spec.channels = audio_codec_ctx->ch_layout.nb_channels;
+        audio_spec.silence = 0;
+        audio_spec.samples = AUDIO_BUFFER_SIZE;
+        audio_spec.callback = audio_callback;
+        audio_spec.userdata = audio_codec_ctx;
+
+        if (SDL_OpenAudio(&audio_spec, nullptr) < 0) {
+            cerr << "Can't open SDL audio with error: " << SDL_GetError() << endl;
+            return OPEN_SDL_AUDIO_ERROR;
+        }
 
-    // Init SDL library for output frame on screen
-    if ((ret = init_sdl(video_codec_ctx->width, video_codec_ctx->height)) < 0) {
-        return ret;
+        SDL_PauseAudio(0);
     }
 
-    /* Setup SDL audio */
-    audio_spec.freq = audio_codec_ctx->sample_rate;
-    audio_spec.format = AUDIO_S16SYS;
-    audio_spec.channels = video_codec_ctx->ch_layout.nb_channels;
-    audio_spec.silence = 0;
-    audio_spec.samples = AUDIO_BUFFER_SIZE;
-    audio_spec.callback = audio_callback;
-    audio_spec.userdata = audio_codec_ctx;
+    if (audio_codec_ctx != nullptr) {
+        ret = swr_alloc_set_opts2(&swr_ctx,
+                                  &audio_codec_ctx->ch_layout, AV_SAMPLE_FMT_S16, audio_codec_ctx->sample_rate,
+                                  &audio_codec_ctx->ch_layout, audio_codec_ctx->sample_fmt, audio_codec_ctx->sample_rate,
+                                  0, nullptr);
+        if (ret < 0) {
+            cerr << "Can't alloc SwrContext." << endl;
+            return ALLOC_SWR_CONTEXT_ERROR;
+        }
 
-    if (SDL_OpenAudio(&audio_spec, nullptr) < 0) {
-        cerr << "Can't open SDL audio with error: " << SDL_GetError() << endl;
-        return OPEN_SDL_AUDIO_ERROR;
+        ret = swr_init(swr_ctx);
+        if (ret < 0) {
+            cerr << "Can't init SwrContext." << endl;
+            return INIT_SWR_CONTEXT_ERROR;
+        }
     }
 
-    SDL_PauseAudio(0);
+    uint8_t *audio_data[4] = {nullptr};
+    int audio_linesize[4] = {0};
 
-    ret = swr_alloc_set_opts2(&swr_ctx,
-                              &audio_codec_ctx->ch_layout, AV_SAMPLE_FMT_S16, audio_codec_ctx->sample_rate,
-                              &audio_codec_ctx->ch_layout, audio_codec_ctx->sample_fmt, audio_codec_ctx->sample_rate,
-                              0, nullptr);
-    if (ret < 0) {
-        cerr << "Can't alloc SwrContext." << endl;
-        return ALLOC_SWR_CONTEXT_ERROR;
+    // Drop or degrade video frames when we can't keep up with sync clock
+    FRAME_DROPPER frame_dropper(video_codec_ctx);
+
+    /* Alloc pictures shared between decode thread and render loop */
+    PICTURE_QUEUE picture_queue;
+    if ((ret = picture_queue.init(display_width, display_height)) < 0) {
+        return ret;
     }
 
-    ret = swr_init(swr_ctx);
-    if (ret < 0) {
-        cerr << "Can't init SwrContext." << endl;
-        return INIT_SWR_CONTEXT_ERROR;
+    STAGE_TIMER stage_timer;
+
+    /* Read packets on demux thread, video packets are decoded by decode thread and audio packets by audio callback */
+    PACKET_QUEUE video_packet_queue;
+    DEMUXER demuxer(format_ctx, video_stream_index, backend->is_realtime() ? audio_stream_index : -1,
+                    &video_packet_queue, audio_packet_queue, &stage_timer);
+    if ((ret = demuxer.start(buffer_seconds)) < 0) {
+        return ret;
     }
 
-    uint8_t *audio_data[4] = {nullptr};
-    int audio_linesize[4] = {0};
+    AVRational frame_rate = video_stream ? av_guess_frame_rate(format_ctx, video_stream, nullptr) : AVRational{0, 1};
+    DECODE_CONTEXT decode_ctx = {
+        &video_packet_queue, video_codec_ctx, video_stream, frame, &scaler, &frame_dropper, &picture_queue, &stage_timer,
+        display_width, display_height, frame_rate.num > 0 ? av_q2d(av_inv_q(frame_rate)) : 0.0, backend->is_realtime()
+    };
 
-    // Read packet and decode into frame
-    while (av_read_frame(format_ctx, packet) >= 0) {
-        if (quit) break;
+    SDL_Thread *decode_tid = SDL_CreateThread(decode_thread, "decode", &decode_ctx);
+    if (decode_tid == nullptr) {
+        cerr << "Can't create decode thread with error: " << SDL_GetError() << endl;
+        return CREATE_DECODE_THREAD_ERROR;
+    }
 
-        // Video stream
-        if (packet->stream_index == video_stream_index) {
-            ret = avcodec_send_packet(video_codec_ctx, packet);
-            if (ret < 0 && ret != AVERROR(EAGAIN)) {
-                cerr << "Error when sending video packet." << endl;
-                return SEND_VIDEO_PACKET_ERROR;
-            }
+    /* Render loop: present every picture at its pts (or as fast as possible without display), vsync is only used when asked for */
+    FRAME_PACER frame_pacer;
+    long presented_frames = 0;
 
-            while (ret >= 0) {
-                ret = avcodec_receive_frame(video_codec_ctx, frame);
-
-                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
-                else if (ret < 0) {
-                    cerr << "Error when receive video frame." << endl;
-                    return RECEIVE_VIDEO_FRAME_ERROR;
-                }
-
-                if (video_codec_ctx->pix_fmt != AV_PIX_FMT_YUV420P) {
-                    /* Convert frame pixel format to RGB24 format */
-                    sws_scale(sws_ctx, frame->data, frame->linesize, 0, video_codec_ctx->height, yuv420_frame, yuv420_frame_linesize);
-                    SDL_UpdateYUVTexture(texture, nullptr,
-                                         yuv420_frame[0], yuv420_frame_linesize[0],
-                                         yuv420_frame[1], yuv420_frame_linesize[1],
-                                         yuv420_frame[2], yuv420_frame_linesize[2]);
-                }
-                else {
-                    SDL_UpdateYUVTexture(texture, nullptr,
-                                         frame->data[0], frame->linesize[0],
-                                         frame->data[1], frame->linesize[1],
-                                         frame->data[2], frame->linesize[2]);
-                }
-
-                // Clear renderer
-                SDL_RenderClear(renderer);
-
-                // Copy texture to renderer
-                SDL_RenderCopy(renderer, texture, nullptr, &display_rect);
-
-                // Rendering video frame
-                SDL_RenderPresent(renderer);
-
-                double pts = (double)frame->pts * (double)video_stream->time_base.num / (double)video_stream->time_base.den * 1000.0;
-                // printf("video pts: %f\n", pts);
-
-                av_frame_unref(frame);
-            }
+    // Playback end once every picture is presented and audio left in queue is played
+    while (!quit && !(picture_queue.is_drained() && demuxer.is_finished() && audio_packet_queue->length() == 0)) {
+        if (backend->poll_quit()) quit = true;
 
-            av_packet_unref(packet);
-        }
+        VIDEO_PICTURE *picture = picture_queue.peek_readable(RENDER_POLL_MS);
+        if (picture == nullptr) continue;
 
-        // Audio stream
-        else if (packet->stream_index == audio_stream_index) {
-            audio_packet_queue->push(packet);
-        }
+        if (backend->is_realtime()) {
+            // A frame far ahead of the clock would freeze the window for the whole gap, jump the clock to it instead
+            if (picture->pts - sync_clock.get() > PACER_MAX_WAIT) sync_clock.start(picture->pts);
 
-        else {
-            av_packet_unref(packet);
+            while (!quit && !FRAME_PACER::wait_until(sync_clock, picture->pts)) {
+                if (backend->poll_quit()) quit = true;
+            }
+            if (quit) break;
         }
 
-        while (SDL_PollEvent(&event)) {
-            if (event.type == SDL_QUIT) quit = true;
+        Uint64 stage_begin = STAGE_TIMER::now();
+        backend->upload(picture->data, picture->linesize);
+        stage_timer.add(STAGE_UPLOAD, stage_begin);
 
-            if (event.type == SDL_KEYUP) {
-                switch (event.key.keysym.sym) {
-                    case SDLK_ESCAPE:
-                        quit = true;
-                        break;
+        stage_begin = STAGE_TIMER::now();
+        backend->present();
+        stage_timer.add(STAGE_PRESENT, stage_begin);
+        if (presented_frames == 0) print_time_to_first_frame(launched, stream_info_time, stream_info_cached);
+        if (use_pipe) pipe_input.record_latency(picture->pos);
 
-                    default:
-                        cout << "Unhandled key" << endl;
-                        break;
-                }
-            }
-        }
+        if (backend->is_realtime()) frame_pacer.record(sync_clock.get() - picture->pts);
+        picture_queue.pop();
+        presented_frames++;
     }
 
+    // Stop audio, demux and decode threads if they are still running
+    quit = true;
+    picture_queue.abort();
+    video_packet_queue.abort();
+    audio_packet_queue->abort();
+    if (audio_codec_ctx != nullptr && backend->is_realtime()) SDL_CloseAudio();
+
+    int demux_ret = demuxer.stop();
+    SDL_WaitThread(decode_tid, &ret);
+    if (ret < 0) {
+        return ret;
+    }
+    if (demux_ret < 0) {
+        return demux_ret;
+    }
+
+    frame_pacer.report();
+    frame_dropper.report();
+    demuxer.report();
+    stage_timer.report(presented_frames);
+    if (use_read_ahead) read_ahead_input.report();
+    if (use_pipe) pipe_input.report(opened);
+
     av_frame_free(&frame);
-    av_packet_free(&packet);
     avcodec_free_context(&video_codec_ctx);
     avcodec_free_context(&audio_codec_ctx);
-    sws_freeContext(sws_ctx);
     avformat_free_context(format_ctx);
 
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyTexture(texture);
-    SDL_DestroyWindow(window);
+    delete backend;
     cout << "COMPLETE" << endl;
 
     return 0;
@@ -0,0 +1,224 @@
+#ifndef TUTORIAL_03_MEMORY_INPUT_H
+#define TUTORIAL_03_MEMORY_INPUT_H
+
+#include "iostream"
+#include "string"
+#include "vector"
+#include "cstdio"
+#include "cstring"
+#include "algorithm"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include "windows.h"
+#else
+#include "fcntl.h"
+#include "unistd.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#endif
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavformat/avio.h"
+#include "libavutil/mem.h"
+}
+
+// Size of AVIOContext buffer, reads bigger than it are served straight into the demuxer destination
+const int MEMORY_INPUT_BUFFER_SIZE = 32 * 1024;
+
+/**
+ * Media already in memory served to the demuxer through a custom AVIOContext, no file is touched while demuxing.
+ *
+ * @note Data is never copied into a staging buffer: read callback copy from the caller memory into the buffer given
+ *       by libavformat, and reads bigger than the AVIOContext buffer (most packet payloads) are asked by libavformat
+ *       straight into the packet. Memory can be a caller buffer, a whole file loaded up front (so benchmarks measure
+ *       demux and decode without the filesystem) or a named shared-memory segment filled by another process.
+ */
+struct MEMORY_INPUT {
+private:
+    const uint8_t *data;
+    int64_t size;
+    int64_t position;
+    AVIOContext *avio_ctx;
+    std::vector<uint8_t> owned;     // Content of a loaded file
+    void *shared;                   // Mapping of a shared-memory segment
+#ifdef _WIN32
+    HANDLE shared_handle;
+#endif
+
+    static int read_packet(void *opaque, uint8_t *buffer, int buffer_size) {
+        auto *input = (MEMORY_INPUT*)opaque;
+
+        int64_t left = input->size - input->position;
+        if (left <= 0) return AVERROR_EOF;
+
+        int size = (int)std::min((int64_t)buffer_size, left);
+        memcpy(buffer, input->data + input->position, size);
+        input->position += size;
+
+        return size;
+    }
+
+    static int64_t seek(void *opaque, int64_t offset, int whence) {
+        auto *input = (MEMORY_INPUT*)opaque;
+        int64_t position;
+
+        switch (whence & ~AVSEEK_FORCE) {
+            case AVSEEK_SIZE:   return input->size;
+            case SEEK_SET:      position = offset; break;
+            case SEEK_CUR:      position = input->position + offset; break;
+            case SEEK_END:      position = input->size + offset; break;
+            default:            return AVERROR(EINVAL);
+        }
+
+        if (position < 0 || position > input->size) return AVERROR(EINVAL);
+
+        input->position = position;
+        return position;
+    }
+
+    void unmap_shared() {
+#ifdef _WIN32
+        if (this->shared) UnmapViewOfFile(this->shared);
+        if (this->shared_handle) CloseHandle(this->shared_handle);
+        this->shared_handle = nullptr;
+#else
+        if (this->shared) munmap(this->shared, (size_t)this->size);
+#endif
+        this->shared = nullptr;
+    }
+
+public:
+    MEMORY_INPUT() {
+        this->data          = nullptr;
+        this->size          = 0;
+        this->position      = 0;
+        this->avio_ctx      = nullptr;
+        this->shared        = nullptr;
+#ifdef _WIN32
+        this->shared_handle = nullptr;
+#endif
+    }
+
+    /**
+     * Must be destroyed after the format context using it is closed.
+     */
+    ~MEMORY_INPUT() {
+        if (this->avio_ctx) {
+            av_freep(&this->avio_ctx->buffer);
+            avio_context_free(&this->avio_ctx);
+        }
+        unmap_shared();
+    }
+
+    MEMORY_INPUT(const MEMORY_INPUT&) = delete;
+    MEMORY_INPUT &operator=(const MEMORY_INPUT&) = delete;
+
+    /**
+     * Make format context read from a buffer owned by caller.
+     * @param buffer media data, must stay alive and unchanged until format context is closed.
+     * @param buffer_size size of media data in bytes.
+     * @param format_ctx format context not opened yet, from avformat_alloc_context.
+     * @return true when input is set up, false on allocation failure and format context is left untouched.
+     */
+    bool attach(const uint8_t *buffer, int64_t buffer_size, AVFormatContext *format_ctx) {
+        auto *io_buffer = (uint8_t*)av_malloc(MEMORY_INPUT_BUFFER_SIZE);
+        if (io_buffer == nullptr) return false;
+
+        this->avio_ctx = avio_alloc_context(io_buffer, MEMORY_INPUT_BUFFER_SIZE, 0, this, read_packet, nullptr, seek);
+        if (this->avio_ctx == nullptr) {
+            av_free(io_buffer);
+            return false;
+        }
+
+        this->data      = buffer;
+        this->size      = buffer_size;
+        this->position  = 0;
+
+        format_ctx->pb = this->avio_ctx;
+        format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+        return true;
+    }
+
+    /**
+     * Read whole file into memory and make format context read from it.
+     * @param path path of local file.
+     * @param format_ctx format context not opened yet, from avformat_alloc_context.
+     * @return true when input is loaded, false when file can't be read and format context is left untouched.
+     */
+    bool load_file(const std::string &path, AVFormatContext *format_ctx) {
+        FILE *file = fopen(path.data(), "rb");
+        if (file == nullptr) return false;
+
+        uint8_t chunk[64 * 1024];
+        size_t read_size;
+        while ((read_size = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            this->owned.insert(this->owned.end(), chunk, chunk + read_size);
+        }
+        bool failed = ferror(file) != 0;
+        fclose(file);
+
+        if (failed || this->owned.empty()) return false;
+        return attach(this->owned.data(), (int64_t)this->owned.size(), format_ctx);
+    }
+
+    /**
+     * Map a named shared-memory segment read-only and make format context read from it.
+     * @param name name of segment ("/name" for shm_open, a file mapping object name on Windows).
+     * @param format_ctx format context not opened yet, from avformat_alloc_context.
+     * @return true when segment is mapped, false when it can't be opened and format context is left untouched.
+     *
+     * @note Whole segment is taken as media, writer must size it exactly (ftruncate) before it is opened here. On
+     *       Windows size is rounded up to whole pages, trailing zeros are ignored by most demuxers.
+     */
+    bool attach_shared_memory(const std::string &name, AVFormatContext *format_ctx) {
+#ifdef _WIN32
+        this->shared_handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name.data());
+        if (this->shared_handle == nullptr) return false;
+
+        this->shared = MapViewOfFile(this->shared_handle, FILE_MAP_READ, 0, 0, 0);
+        if (this->shared == nullptr) {
+            unmap_shared();
+            return false;
+        }
+
+        MEMORY_BASIC_INFORMATION info = {};
+        VirtualQuery(this->shared, &info, sizeof(info));
+        this->size = (int64_t)info.RegionSize;
+#else
+        int fd = shm_open(name.data(), O_RDONLY, 0);
+        if (fd < 0) return false;
+
+        struct stat info = {};
+        if (fstat(fd, &info) < 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+
+        void *mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) return false;
+
+        this->shared = mapping;
+        this->size = info.st_size;
+#endif
+
+        if (!attach((const uint8_t*)this->shared, this->size, format_ctx)) {
+            unmap_shared();
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Get size of media in memory.
+     */
+    int64_t input_size() const {
+        return this->size;
+    }
+};
+
+#endif //TUTORIAL_03_MEMORY_INPUT_H
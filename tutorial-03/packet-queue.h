@@ -0,0 +1,212 @@
+#ifndef TUTORIAL_03_PACKET_QUEUE_H
+#define TUTORIAL_03_PACKET_QUEUE_H
+
+#include "cstdlib"
+#include "SDL.h"
+#include "SDL_thread.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavutil/avutil.h"
+}
+
+/**
+ * Queue implement for store AVPacket.
+ *
+ * @note Besides bytes and packets the queue know how much media time it holds, from dts of oldest and newest packet,
+ *       so demux thread can buffer by duration whatever the bitrate is. Every "get" signal the "pop" condition given
+ *       with "set_pop_cond", which is how a demux thread sleeping on a full buffer is woken up.
+ */
+struct PACKET_QUEUE {
+private:
+    AVPacketList *first_packet;
+    AVPacketList *last_packet;
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    SDL_cond *pop_cond;
+    AVRational time_base;
+    int64_t last_dts;
+    int64_t last_duration;
+    bool finished;
+    bool aborted;
+    int _size;
+    int _length;
+
+public:
+    PACKET_QUEUE() {
+        this->first_packet      = nullptr;
+        this->last_packet       = nullptr;
+        this->mutex             = SDL_CreateMutex();
+        this->cond              = SDL_CreateCond();
+        this->pop_cond          = nullptr;
+        this->time_base         = {0, 1};
+        this->last_dts          = AV_NOPTS_VALUE;
+        this->last_duration     = 0;
+        this->finished          = false;
+        this->aborted           = false;
+        this->_size              = 0;
+        this->_length            = 0;
+    }
+
+    ~PACKET_QUEUE() {
+        while (this->first_packet) {
+            AVPacketList *packet_list = this->first_packet;
+            this->first_packet = packet_list->next;
+            av_packet_unref(&packet_list->pkt);
+            free(packet_list);
+        }
+
+        SDL_DestroyCond(this->cond);
+        SDL_DestroyMutex(this->mutex);
+    }
+
+    /**
+     * Set time base of packets, needed by "duration".
+     * @param stream_time_base time base of stream whose packets are queued.
+     */
+    void set_time_base(AVRational stream_time_base) {
+        this->time_base = stream_time_base;
+    }
+
+    /**
+     * Set condition signaled every time a packet is taken out of queue.
+     * @param cond condition, nullptr for none.
+     */
+    void set_pop_cond(SDL_cond *cond) {
+        this->pop_cond = cond;
+    }
+
+    /**
+     * Get size in bytes of all packets stored.
+     * @return size in bytes.
+     */
+    int size() const {
+        return this->_size;
+    }
+
+    /**
+     * Get number of packet stored in this queue.
+     * @return number of packet.
+     */
+    int length() const {
+        return this->_length;
+    }
+
+    /**
+     * Get media time stored in this queue.
+     * @return duration in seconds, 0 when time base is not set or packets have no dts.
+     */
+    double duration() {
+        SDL_LockMutex(this->mutex);
+        double seconds = 0.0;
+        if (this->first_packet && this->time_base.num > 0 && this->first_packet->pkt.dts != AV_NOPTS_VALUE
+            && this->last_dts != AV_NOPTS_VALUE) {
+            seconds = (double)(this->last_dts - this->first_packet->pkt.dts + this->last_duration) * av_q2d(this->time_base);
+        }
+        SDL_UnlockMutex(this->mutex);
+
+        return seconds > 0.0 ? seconds : 0.0;
+    }
+
+    /**
+     * Push new AVPacket in queue.
+     * @note Do not apply "av_packet_unref" or "av_packet_free" with packet passed into this function.
+     * @param packet packet want to store.
+     */
+    void push(AVPacket *packet) {
+        SDL_LockMutex(this->mutex);
+
+        auto *next_packet   = (AVPacketList*)(malloc(sizeof(AVPacketList)));
+        next_packet->pkt    = *packet;
+        next_packet->next   = nullptr;
+
+        if (!this->first_packet) {
+            this->first_packet  = next_packet;
+            this->last_packet   = next_packet;
+        }
+        else {
+            this->last_packet->next = next_packet;
+            this->last_packet = this->last_packet->next;
+        }
+
+        this->_size += packet->size;
+        this->_length += 1;
+        if (packet->dts != AV_NOPTS_VALUE) {
+            this->last_dts      = packet->dts;
+            this->last_duration = packet->duration;
+        }
+
+        SDL_UnlockMutex(this->mutex);
+        SDL_CondSignal(this->cond);
+    }
+
+    /**
+     * Retrieves a packet that has been pushed to the queue.
+     * @note AVPacket receive from this function need to be free with "av_packet_free" when they are no longer needed.
+     * @param wait if "wait" is true thread will be blocked if no packet in queue until a new packet pushed.
+     * @return "AVPacket" pointer or "nullptr" when no packet in queue ("nullptr" is returned while waiting only when
+     *         queue is finished and empty or aborted).
+     */
+    AVPacket *get(bool wait) {
+        SDL_LockMutex(this->mutex);
+        AVPacket *transit_packet = nullptr;
+
+        for(;;) {
+            if (this->aborted) {
+                break;
+            }
+            else if (this->first_packet) {
+                /* Update size and length of this queue */
+                this->_size -= this->first_packet->pkt.size;
+                this->_length -= 1;
+
+                // Alloc memory for a transit packet
+                transit_packet = av_packet_alloc();
+
+
+                // Copy data from packet stored in first_packet to transit_packet
+                *transit_packet = this->first_packet->pkt;
+
+                /* Move first_packet to next packet list and free old data */
+                AVPacketList *transit_packet_list = this->first_packet;
+                this->first_packet = this->first_packet->next;
+                free(transit_packet_list);
+
+                if (this->pop_cond) SDL_CondSignal(this->pop_cond);
+                break;
+            }
+            else if (wait && !this->finished) {
+                // Unlock mute and freeze this thread until we reached SDL_CondSignal and thread will continue from here
+                SDL_CondWait(this->cond, this->mutex);
+            }
+            else {
+                break;
+            }
+        }
+
+        SDL_UnlockMutex(this->mutex);
+        return transit_packet;
+    }
+
+    /**
+     * Writer call this when no more packets will be pushed, readers get "nullptr" once queue is empty.
+     */
+    void finish() {
+        SDL_LockMutex(this->mutex);
+        this->finished = true;
+        SDL_CondBroadcast(this->cond);
+        SDL_UnlockMutex(this->mutex);
+    }
+
+    /**
+     * Wake up every waiting reader, after this "get" always return "nullptr".
+     */
+    void abort() {
+        SDL_LockMutex(this->mutex);
+        this->aborted = true;
+        SDL_CondBroadcast(this->cond);
+        SDL_UnlockMutex(this->mutex);
+    }
+};
+
+#endif //TUTORIAL_03_PACKET_QUEUE_H
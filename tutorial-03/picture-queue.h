@@ -0,0 +1,180 @@
+#ifndef TUTORIAL_03_PICTURE_QUEUE_H
+#define TUTORIAL_03_PICTURE_QUEUE_H
+
+#include "iostream"
+#include "SDL.h"
+#include "SDL_thread.h"
+#include "error-code.h"
+
+extern "C" {
+#include "libavutil/imgutils.h"
+}
+
+// Number of converted pictures decode thread can prepare ahead of render thread
+const int PICTURE_QUEUE_SIZE = 3;
+
+/**
+ * A converted YUV420 picture ready to upload, with time it should be presented.
+ */
+struct VIDEO_PICTURE {
+    uint8_t *data[4];
+    int linesize[4];
+    double pts;
+    int64_t pos;                // Input offset of packet picture was decoded from, -1 when unknown
+};
+
+/**
+ * Fixed size ring of pictures between decode thread (writer) and render thread (reader).
+ *
+ * @note Buffers are allocated once in "init", writer convert frame straight into a free slot so no extra copy is made.
+ */
+struct PICTURE_QUEUE {
+private:
+    VIDEO_PICTURE pictures[PICTURE_QUEUE_SIZE];
+    int read_index;
+    int write_index;
+    int _length;
+    bool finished;
+    bool aborted;
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+
+public:
+    PICTURE_QUEUE() {
+        this->read_index    = 0;
+        this->write_index   = 0;
+        this->_length       = 0;
+        this->finished      = false;
+        this->aborted       = false;
+        this->mutex         = SDL_CreateMutex();
+        this->cond          = SDL_CreateCond();
+
+        for (auto &picture : this->pictures) {
+            for (int i = 0; i < 4; ++i) {
+                picture.data[i]     = nullptr;
+                picture.linesize[i] = 0;
+            }
+            picture.pts = 0.0;
+            picture.pos = -1;
+        }
+    }
+
+    ~PICTURE_QUEUE() {
+        for (auto &picture : this->pictures) av_freep(&picture.data[0]);
+
+        SDL_DestroyCond(this->cond);
+        SDL_DestroyMutex(this->mutex);
+    }
+
+    /**
+     * Alloc buffer of every picture.
+     * @param width width of picture.
+     * @param height height of picture.
+     * @return 0 on success or negative error code on failure.
+     */
+    int init(int width, int height) {
+        for (auto &picture : this->pictures) {
+            if (av_image_alloc(picture.data, picture.linesize, width, height, AV_PIX_FMT_YUV420P, 1) < 0) {
+                std::cerr << "Can't alloc memory for picture queue." << std::endl;
+                return ALLOC_RGB_FRAME_ERROR;
+            }
+        }
+
+        return 0;
+    }
+
+    /**
+     * Get number of pictures waiting to be presented.
+     * @return number of pictures.
+     */
+    int length() const {
+        return this->_length;
+    }
+
+    /**
+     * Get a free picture to write into, thread will be blocked until render thread release one.
+     * @return free picture or "nullptr" when queue is aborted.
+     */
+    VIDEO_PICTURE *peek_writable() {
+        SDL_LockMutex(this->mutex);
+        while (this->_length >= PICTURE_QUEUE_SIZE && !this->aborted) {
+            SDL_CondWait(this->cond, this->mutex);
+        }
+        VIDEO_PICTURE *picture = this->aborted ? nullptr : &this->pictures[this->write_index];
+        SDL_UnlockMutex(this->mutex);
+
+        return picture;
+    }
+
+    /**
+     * Make picture returned from "peek_writable" visible to reader.
+     */
+    void push() {
+        SDL_LockMutex(this->mutex);
+        this->write_index = (this->write_index + 1) % PICTURE_QUEUE_SIZE;
+        this->_length += 1;
+        SDL_CondSignal(this->cond);
+        SDL_UnlockMutex(this->mutex);
+    }
+
+    /**
+     * Get next picture to present.
+     * @param timeout_ms max time to wait for a picture.
+     * @return next picture or "nullptr" on timeout, when queue is finished and empty or when queue is aborted.
+     */
+    VIDEO_PICTURE *peek_readable(Uint32 timeout_ms) {
+        SDL_LockMutex(this->mutex);
+        if (this->_length == 0 && !this->finished && !this->aborted) {
+            SDL_CondWaitTimeout(this->cond, this->mutex, timeout_ms);
+        }
+        VIDEO_PICTURE *picture = (this->_length == 0 || this->aborted) ? nullptr : &this->pictures[this->read_index];
+        SDL_UnlockMutex(this->mutex);
+
+        return picture;
+    }
+
+    /**
+     * Release picture returned from "peek_readable" so writer can reuse it.
+     */
+    void pop() {
+        SDL_LockMutex(this->mutex);
+        this->read_index = (this->read_index + 1) % PICTURE_QUEUE_SIZE;
+        this->_length -= 1;
+        SDL_CondSignal(this->cond);
+        SDL_UnlockMutex(this->mutex);
+    }
+
+    /**
+     * Writer call this when no more pictures will be pushed.
+     */
+    void finish() {
+        SDL_LockMutex(this->mutex);
+        this->finished = true;
+        SDL_CondSignal(this->cond);
+        SDL_UnlockMutex(this->mutex);
+    }
+
+    /**
+     * Check writer finished and every picture has been presented.
+     * @return true when nothing left to present.
+     */
+    bool is_drained() {
+        SDL_LockMutex(this->mutex);
+        bool drained = this->finished && this->_length == 0;
+        SDL_UnlockMutex(this->mutex);
+
+        return drained;
+    }
+
+    /**
+     * Wake up every thread waiting on this queue, after this no picture will be returned.
+     */
+    void abort() {
+        SDL_LockMutex(this->mutex);
+        this->aborted = true;
+        SDL_CondBroadcast(this->cond);
+        SDL_UnlockMutex(this->mutex);
+    }
+};
+
+#endif //TUTORIAL_03_PICTURE_QUEUE_H
@@ -0,0 +1,255 @@
+#ifndef TUTORIAL_03_RENDER_BACKEND_H
+#define TUTORIAL_03_RENDER_BACKEND_H
+
+#include "iostream"
+#include "cstring"
+#include "SDL.h"
+#include "error-code.h"
+
+/**
+ * Where converted YUV420 pictures go.
+ *
+ * @note Only window backend show anything on screen and need frames paced at their pts, the other backends are used to
+ *       measure throughput of the pipeline as fast as it can run without a display.
+ */
+struct RENDER_BACKEND {
+    virtual ~RENDER_BACKEND() = default;
+
+    /**
+     * Create everything needed to render picture with given size.
+     * @param width width of picture.
+     * @param height height of picture.
+     * @return 0 on success or negative error code on failure.
+     */
+    virtual int init(int width, int height) = 0;
+
+    /**
+     * Upload a YUV420 picture.
+     * @param data data of each plane.
+     * @param linesize linesize of each plane.
+     */
+    virtual void upload(uint8_t *const data[4], const int linesize[4]) = 0;
+
+    /**
+     * Present last uploaded picture.
+     */
+    virtual void present() = 0;
+
+    /**
+     * Handle pending events.
+     * @return true if user asked to quit.
+     */
+    virtual bool poll_quit() {
+        return false;
+    }
+
+    /**
+     * Check pictures should be presented at their pts or as fast as possible.
+     * @return true when pictures are shown to user.
+     */
+    virtual bool is_realtime() const {
+        return false;
+    }
+
+    virtual const char *name() const = 0;
+};
+
+/**
+ * Render into a visible SDL window.
+ */
+struct SDL_WINDOW_BACKEND : RENDER_BACKEND {
+private:
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    SDL_Rect display_rect;
+    bool vsync;
+
+public:
+    explicit SDL_WINDOW_BACKEND(bool vsync) {
+        this->window        = nullptr;
+        this->renderer      = nullptr;
+        this->texture       = nullptr;
+        this->display_rect  = {0, 0, 0, 0};
+        this->vsync         = vsync;
+    }
+
+    ~SDL_WINDOW_BACKEND() override {
+        if (this->texture) SDL_DestroyTexture(this->texture);
+        if (this->renderer) SDL_DestroyRenderer(this->renderer);
+        if (this->window) SDL_DestroyWindow(this->window);
+    }
+
+    int init(const int SCREEN_WIDTH, const int SCREEN_HEIGHT) override {
+        if ((SDL_Init(SDL_INIT_VIDEO)) < 0) {
+            std::cerr << "Can't init SDL library with error: " << SDL_GetError() << std::endl;
+            return INIT_SDL_LIB_ERROR;
+        }
+
+        this->window = SDL_CreateWindow("FFmpeg tutorial", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+        if (this->window == nullptr) {
+            std::cerr << "Can't create SDL window with error: " << SDL_GetError() << std::endl;
+            return CREATE_SDL_WINDOW_ERROR;
+        }
+
+        this->renderer = SDL_CreateRenderer(this->window, -1, this->vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+        if (this->renderer == nullptr) {
+            std::cerr << "Can't create SDL renderer with error: " << SDL_GetError() << std::endl;
+            return CREATE_SDL_RENDERER_ERROR;
+        }
+
+        this->texture = SDL_CreateTexture(this->renderer, SDL_PIXELFORMAT_IYUV, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+        if (this->texture == nullptr) {
+            std::cerr << "Can't create SDL texture with error: " << SDL_GetError() << std::endl;
+            return CREATE_SDL_TEXTURE_ERROR;
+        }
+
+        this->display_rect.w = SCREEN_WIDTH;
+        this->display_rect.h = SCREEN_HEIGHT;
+
+        return 0;
+    }
+
+    void upload(uint8_t *const data[4], const int linesize[4]) override {
+        SDL_UpdateYUVTexture(this->texture, nullptr,
+                             data[0], linesize[0],
+                             data[1], linesize[1],
+                             data[2], linesize[2]);
+    }
+
+    void present() override {
+        // Clear renderer
+        SDL_RenderClear(this->renderer);
+
+        // Copy texture to renderer
+        SDL_RenderCopy(this->renderer, this->texture, nullptr, &this->display_rect);
+
+        // Rendering video frame
+        SDL_RenderPresent(this->renderer);
+    }
+
+    bool poll_quit() override {
+        SDL_Event event;
+        bool quit = false;
+
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT) quit = true;
+
+            if (event.type == SDL_KEYUP) {
+                switch (event.key.keysym.sym) {
+                    case SDLK_ESCAPE:
+                        quit = true;
+                        break;
+
+                    default:
+                        std::cout << "Unhandled key" << std::endl;
+                        break;
+                }
+            }
+        }
+
+        return quit;
+    }
+
+    bool is_realtime() const override {
+        return true;
+    }
+
+    const char *name() const override {
+        return "window";
+    }
+};
+
+/**
+ * Render with SDL software renderer into an offscreen surface, no window or display is needed.
+ */
+struct SDL_OFFSCREEN_BACKEND : RENDER_BACKEND {
+private:
+    SDL_Surface *surface;
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+
+public:
+    SDL_OFFSCREEN_BACKEND() {
+        this->surface   = nullptr;
+        this->renderer  = nullptr;
+        this->texture   = nullptr;
+    }
+
+    ~SDL_OFFSCREEN_BACKEND() override {
+        if (this->texture) SDL_DestroyTexture(this->texture);
+        if (this->renderer) SDL_DestroyRenderer(this->renderer);
+        if (this->surface) SDL_FreeSurface(this->surface);
+    }
+
+    int init(int width, int height) override {
+        this->surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (this->surface == nullptr) {
+            std::cerr << "Can't create SDL surface with error: " << SDL_GetError() << std::endl;
+            return CREATE_SDL_WINDOW_ERROR;
+        }
+
+        this->renderer = SDL_CreateSoftwareRenderer(this->surface);
+        if (this->renderer == nullptr) {
+            std::cerr << "Can't create SDL software renderer with error: " << SDL_GetError() << std::endl;
+            return CREATE_SDL_RENDERER_ERROR;
+        }
+
+        this->texture = SDL_CreateTexture(this->renderer, SDL_PIXELFORMAT_IYUV, SDL_TEXTUREACCESS_STREAMING, width, height);
+        if (this->texture == nullptr) {
+            std::cerr << "Can't create SDL texture with error: " << SDL_GetError() << std::endl;
+            return CREATE_SDL_TEXTURE_ERROR;
+        }
+
+        return 0;
+    }
+
+    void upload(uint8_t *const data[4], const int linesize[4]) override {
+        SDL_UpdateYUVTexture(this->texture, nullptr,
+                             data[0], linesize[0],
+                             data[1], linesize[1],
+                             data[2], linesize[2]);
+    }
+
+    void present() override {
+        SDL_RenderCopy(this->renderer, this->texture, nullptr, nullptr);
+        SDL_RenderPresent(this->renderer);
+    }
+
+    const char *name() const override {
+        return "offscreen";
+    }
+};
+
+/**
+ * Drop every picture, used to measure decode and convert alone.
+ */
+struct NULL_BACKEND : RENDER_BACKEND {
+    int init(int, int) override {
+        return 0;
+    }
+
+    void upload(uint8_t *const [4], const int [4]) override {}
+
+    void present() override {}
+
+    const char *name() const override {
+        return "null";
+    }
+};
+
+/**
+ * Create render backend with given name.
+ * @param name "window", "offscreen" or "null".
+ * @param vsync make window backend wait for vertical blank when presenting.
+ * @return new backend or "nullptr" when name is unknown.
+ */
+inline RENDER_BACKEND *create_render_backend(const char *name, bool vsync) {
+    if (strcmp(name, "window") == 0) return new SDL_WINDOW_BACKEND(vsync);
+    if (strcmp(name, "offscreen") == 0) return new SDL_OFFSCREEN_BACKEND();
+    if (strcmp(name, "null") == 0) return new NULL_BACKEND();
+
+    return nullptr;
+}
+
+#endif //TUTORIAL_03_RENDER_BACKEND_H
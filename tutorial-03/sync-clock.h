@@ -0,0 +1,55 @@
+#ifndef TUTORIAL_03_SYNC_CLOCK_H
+#define TUTORIAL_03_SYNC_CLOCK_H
+
+#include "SDL.h"
+
+/**
+ * Master clock used to decide when a video frame should be presented.
+ *
+ * @note The clock is anchored to the pts of the first frame, after that it runs with wall time. So the current stream
+ *       time is always "base_pts + elapsed wall time" in seconds.
+ */
+struct SYNC_CLOCK {
+private:
+    double base_pts;
+    Uint64 base_counter;
+    bool started;
+
+public:
+    SYNC_CLOCK() {
+        this->base_pts      = 0.0;
+        this->base_counter  = 0;
+        this->started       = false;
+    }
+
+    /**
+     * Check clock has been anchored or not.
+     * @return true when "start" has been called.
+     */
+    bool is_started() const {
+        return this->started;
+    }
+
+    /**
+     * Anchor clock to given pts, from now the clock will run with wall time.
+     * @param pts stream time in seconds.
+     */
+    void start(double pts) {
+        this->base_pts      = pts;
+        this->base_counter  = SDL_GetPerformanceCounter();
+        this->started       = true;
+    }
+
+    /**
+     * Get current stream time.
+     * @return stream time in seconds.
+     */
+    double get() const {
+        if (!this->started) return 0.0;
+
+        Uint64 elapsed = SDL_GetPerformanceCounter() - this->base_counter;
+        return this->base_pts + (double)elapsed / (double)SDL_GetPerformanceFrequency();
+    }
+};
+
+#endif //TUTORIAL_03_SYNC_CLOCK_H